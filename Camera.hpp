@@ -37,7 +37,7 @@ public:
     // Constructor with vectors
     Camera(glm::vec3 _position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 _up = glm::vec3(0.0f, 1.0f, 0.0f), float _yaw = 45.0f, float _pitch = 0.0f) : front(glm::vec3(0.0f, 0.0f, -1.0f)), speed(2.5f), sensitivity(0.07f), FOV(90.0f)
     {
-        position = position;
+        position = _position;
         worldUp = _up;
         yaw = _yaw;
         pitch = _pitch;
@@ -0,0 +1,271 @@
+#ifndef _H_DYNAMIC_RESOLUTION_
+#define _H_DYNAMIC_RESOLUTION_
+
+#include <glad/glad.h>
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include "Resource.hpp"
+#include "ShaderVariants.hpp"
+
+// Per-frame statistics, updated by BeginFrame
+struct ResolutionStats
+{
+    float scale = 1.0f;      // Render resolution over window resolution, per axis
+    int renderWidth = 0;
+    int renderHeight = 0;
+    float gpuTime = 0.0f;    // Milliseconds the GPU spent on the scene of the latest finished frame
+    float cpuTime = 0.0f;    // Milliseconds spent between BeginFrame and Present on the CPU last frame
+    unsigned int changes = 0;  // Number of times the scale was changed
+};
+
+// Picks the render scale from measured frame times. The cost of a fill rate bound frame grows with the pixel count,
+// so the scale follows the square root of the ratio between the target and the measured time. Scaling down reacts
+// quickly while scaling up creeps back, and there is a dead band between the two so the scale doesn't flip-flop
+// between two sizes. After every change it waits until timings of the new size come in.
+class ResolutionController
+{
+public:
+    // Frames to wait after a change, timer query results arrive a few frames late
+    static const int SETTLE_FRAMES = 4;
+
+    ResolutionController(float _budget = 1000.0f / 60.0f)
+        : budget(_budget), minScale(0.5f), maxScale(1.0f), scale(1.0f), frameTime(0.0f), settle(0), changes(0) {}
+
+    // Feeds the time of a finished frame in milliseconds and returns the scale to render the next frame at
+    float Update(float time)
+    {
+        // Follow slow frames quickly but fast ones slowly, so a single fast frame doesn't scale up. Hitches (and
+        // bogus first query results on some drivers) are clamped so they can't hold the average up for long.
+        time = std::min(time, budget * 4.0f);
+        frameTime = frameTime == 0.0f ? time : frameTime + (time - frameTime) * (time > frameTime ? 0.5f : 0.1f);
+        if (settle > 0) {
+            settle--;
+            return scale;
+        }
+
+        float target = budget * 0.85f;
+        if (frameTime < budget * 0.95f && frameTime > budget * 0.7f)
+            return scale;
+
+        float wanted = scale * sqrt(target / std::max(frameTime, 0.001f));
+        wanted = std::min(std::max(wanted, scale - 0.1f), scale + 0.025f);
+        wanted = std::min(std::max(wanted, minScale), maxScale);
+        if (fabs(wanted - scale) < 0.005f)
+            return scale;
+
+        // Guess what the new size will cost until real timings arrive
+        frameTime *= (wanted * wanted) / (scale * scale);
+        scale = wanted;
+        settle = SETTLE_FRAMES;
+        changes++;
+        return scale;
+    }
+
+    // Frame time budget in milliseconds
+    float getBudget() const { return budget; }
+    void setBudget(float _budget) { budget = _budget; }
+
+    float getMinScale() const { return minScale; }
+    float getMaxScale() const { return maxScale; }
+    void setScaleRange(float _minScale, float _maxScale)
+    {
+        minScale = _minScale;
+        maxScale = std::max(_minScale, _maxScale);
+        scale = std::min(std::max(scale, minScale), maxScale);
+    }
+
+    float getScale() const { return scale; }
+    unsigned int getChanges() const { return changes; }
+
+private:
+    float budget;
+    float minScale;
+    float maxScale;
+    float scale;
+    float frameTime;  // Smoothed frame time
+    int settle;
+    unsigned int changes;
+};
+
+// Renders the scene into an offscreen target at a resolution picked by a ResolutionController, then upscales it to
+// the window. The target is allocated for the largest scale once per window size; smaller scales only render into its
+// bottom left corner, so changing the scale never reallocates anything. The GPU time of the scene is measured with
+// timer queries that are read back a few frames later instead of waiting on them. Until the first result arrives the
+// CPU time between BeginFrame and Present stands in for it.
+class DynamicResolution
+{
+public:
+    static const int QUERY_COUNT = 4;
+
+    // upscale is the blit.vert/upscale.frag program
+    DynamicResolution(ShaderProgram& _upscale, float budget = 1000.0f / 60.0f)
+        : upscale(_upscale), controller(budget), sharpness(0.5f), windowWidth(0), windowHeight(0), targetWidth(0),
+          targetHeight(0), targetScale(0.0f), nextQuery(0), pendingQueries(0)
+    {
+        framebuffer = FramebufferHandle::Create();
+        color = TextureHandle::Create();
+        depth = RenderbufferHandle::Create();
+        vertexArray = VertexArrayHandle::Create();
+        for (int i = 0; i < QUERY_COUNT; i++)
+            queries[i] = QueryHandle::Create();
+    }
+
+    // Picks this frame's scale and binds the offscreen target with a viewport of the render size.
+    // Pass the window's framebuffer size.
+    void BeginFrame(int _windowWidth, int _windowHeight)
+    {
+        cpuStart = std::chrono::high_resolution_clock::now();
+
+        _windowWidth = std::max(_windowWidth, 1);
+        _windowHeight = std::max(_windowHeight, 1);
+        if (_windowWidth != windowWidth || _windowHeight != windowHeight || controller.getMaxScale() != targetScale)
+            Resize(_windowWidth, _windowHeight);
+
+        float scale = controller.getScale();
+        if (ReadQueries())
+            scale = controller.Update(stats.gpuTime);
+        else if (stats.gpuTime == 0.0f && stats.cpuTime > 0.0f)
+            scale = controller.Update(stats.cpuTime);
+
+        stats.scale = scale;
+        stats.renderWidth = std::min(std::max((int)(windowWidth * scale + 0.5f), 1), targetWidth);
+        stats.renderHeight = std::min(std::max((int)(windowHeight * scale + 0.5f), 1), targetHeight);
+        stats.changes = controller.getChanges();
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.Use());
+        glViewport(0, 0, stats.renderWidth, stats.renderHeight);
+        glBeginQuery(GL_TIME_ELAPSED, queries[nextQuery].Use());
+    }
+
+    // Upscales the rendered frame to the window. Call before swapping buffers.
+    void Present()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        nextQuery = (nextQuery + 1) % QUERY_COUNT;
+        pendingQueries++;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, windowWidth, windowHeight);
+
+        // The blit is a single triangle, so it must not be depth tested or drawn as wireframe
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        GLint polygonMode[2] = { GL_FILL, GL_FILL };
+        glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+        glDisable(GL_DEPTH_TEST);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+        // Sharpening only makes up for the blur of upscaling
+        bool upscaled = stats.renderWidth < windowWidth || stats.renderHeight < windowHeight;
+        upscale.Bind();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, color.Use());
+        upscale.setInt("sceneColor", 0);
+        upscale.setVec2("uvScale", (float)stats.renderWidth / targetWidth, (float)stats.renderHeight / targetHeight);
+        upscale.setVec2("texelSize", 1.0f / targetWidth, 1.0f / targetHeight);
+        upscale.setFloat("sharpness", upscaled ? sharpness : 0.0f);
+        glBindVertexArray(vertexArray.Use());
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+        glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+
+        stats.cpuTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - cpuStart).count();
+    }
+
+    // Size of the current frame's viewport in the offscreen target
+    int getRenderWidth() const { return stats.renderWidth; }
+    int getRenderHeight() const { return stats.renderHeight; }
+
+    // Window size as of the last BeginFrame, use it for the aspect ratio
+    int getWindowWidth() const { return windowWidth; }
+    int getWindowHeight() const { return windowHeight; }
+    float getAspect() const { return (float)windowWidth / windowHeight; }
+
+    const ResolutionStats& getStats() const { return stats; }
+
+    ResolutionController& getController() { return controller; }
+
+    // Strength of the sharpening applied when upscaling, 0 disables it
+    float getSharpness() const { return sharpness; }
+    void setSharpness(float _sharpness) { sharpness = _sharpness; }
+
+private:
+    ShaderProgram& upscale;
+    ResolutionController controller;
+    float sharpness;
+
+    FramebufferHandle framebuffer;
+    TextureHandle color;
+    RenderbufferHandle depth;
+    VertexArrayHandle vertexArray;  // Empty, core profiles can't draw without one
+    QueryHandle queries[QUERY_COUNT];
+
+    int windowWidth, windowHeight;
+    int targetWidth, targetHeight;  // Allocated size of the offscreen target
+    float targetScale;              // Largest scale the target was allocated for
+    int nextQuery;
+    int pendingQueries;
+    std::chrono::high_resolution_clock::time_point cpuStart;
+    ResolutionStats stats;
+
+    // Allocates the offscreen target for the largest scale at this window size
+    void Resize(int _windowWidth, int _windowHeight)
+    {
+        windowWidth = _windowWidth;
+        windowHeight = _windowHeight;
+        targetScale = controller.getMaxScale();
+        targetWidth = std::max((int)ceil(windowWidth * targetScale), 1);
+        targetHeight = std::max((int)ceil(windowHeight * targetScale), 1);
+
+        glBindTexture(GL_TEXTURE_2D, color.Use());
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, targetWidth, targetHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        color.setSize((size_t)targetWidth * targetHeight * 4);
+
+        glBindRenderbuffer(GL_RENDERBUFFER, depth.Use());
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, targetWidth, targetHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        depth.setSize((size_t)targetWidth * targetHeight * 4);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.Use());
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color.get(), 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth.get());
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "ERROR: Dynamic resolution framebuffer is incomplete\n";
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        #ifdef _DEBUG
+            std::cout << "Dynamic resolution target: " << targetWidth << "x" << targetHeight << "\n";
+        #endif
+    }
+
+    // Collects finished timer queries without waiting, unless every query is still in flight. Returns true if a new
+    // GPU time came in.
+    bool ReadQueries()
+    {
+        bool updated = false;
+        while (pendingQueries > 0) {
+            GLuint query = queries[(nextQuery + QUERY_COUNT - pendingQueries) % QUERY_COUNT].get();
+            GLint available = 0;
+            glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available && pendingQueries < QUERY_COUNT)
+                break;
+
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            stats.gpuTime = elapsed / 1000000.0f;
+            pendingQueries--;
+            updated = true;
+        }
+        return updated;
+    }
+};
+
+#endif
@@ -0,0 +1,648 @@
+#ifndef _H_FILESYSTEM_
+#define _H_FILESYSTEM_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// LZ4 isn't bundled, define NGE_USE_LZ4 and link against it to read and write compressed entries
+#ifdef NGE_USE_LZ4
+#include <lz4.h>
+#endif
+
+// Non-owning view of a block of bytes, like std::span<const unsigned char>. Views returned by the file system stay
+// valid until the pack they point into is unmounted or the file system's cache is released, loose files only until
+// they are read again after changing.
+struct ByteView
+{
+    const unsigned char* data;
+    size_t size;
+
+    ByteView() : data(nullptr), size(0) {}
+    ByteView(const unsigned char* _data, size_t _size) : data(_data), size(_size) {}
+
+    const unsigned char* begin() const { return data; }
+    const unsigned char* end() const { return data + size; }
+    bool empty() const { return size == 0; }
+    explicit operator bool() const { return data != nullptr; }
+
+    std::string toString() const { return std::string((const char*)data, size); }
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() : data(nullptr), size(0)
+    {
+#ifdef _WIN32
+        file = INVALID_HANDLE_VALUE;
+        mapping = NULL;
+#else
+        fd = -1;
+#endif
+    }
+    ~MappedFile(void) { Close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const char* path)
+    {
+        Close();
+#ifdef _WIN32
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            Close();
+            return false;
+        }
+        size = (size_t)fileSize.QuadPart;
+
+        // Empty files can't be mapped, but they are still valid files
+        if (size == 0)
+            return true;
+
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL) {
+            Close();
+            return false;
+        }
+        data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+        fd = open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+            Close();
+            return false;
+        }
+        size = (size_t)info.st_size;
+
+        if (size == 0)
+            return true;
+
+        void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        data = mapped == MAP_FAILED ? nullptr : (const unsigned char*)mapped;
+#endif
+        if (!data) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping != NULL)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+        mapping = NULL;
+#else
+        if (data)
+            munmap((void*)data, size);
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    ByteView getView() const { return ByteView(data ? data : (const unsigned char*)"", size); }
+
+private:
+    const unsigned char* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+};
+
+// Size and modification time of a file, used to notice when a file was changed
+struct FileStamp
+{
+    uint64_t size;
+    int64_t modified;
+
+    bool operator==(const FileStamp& other) const { return size == other.size && modified == other.modified; }
+    bool operator!=(const FileStamp& other) const { return !(*this == other); }
+};
+
+// Returns false if the path doesn't exist or isn't a regular file
+inline bool getFileStamp(const char* path, FileStamp& stamp)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info) || (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        return false;
+    stamp.size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    stamp.modified = (int64_t)(((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime);
+#else
+    struct stat info;
+    if (stat(path, &info) != 0 || !S_ISREG(info.st_mode))
+        return false;
+    stamp.size = (uint64_t)info.st_size;
+#ifdef __APPLE__
+    stamp.modified = (int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    stamp.modified = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+#endif
+    return true;
+}
+
+// ===================== Pack format =====================
+//
+// [PackHeader] [entry data, each aligned to header.alignment] [PackEntry index, sorted by hash] [path strings]
+//
+// All values are little-endian. Paths are stored relative to the packed directory with forward slashes, and looked
+// up by the FNV-1a hash of that path.
+
+const uint32_t PACK_MAGIC = 0x5045474E; // "NGEP"
+const uint32_t PACK_VERSION = 1;
+const uint32_t PACK_ENTRY_LZ4 = 1 << 0;
+
+struct PackHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t alignment;
+    uint64_t indexOffset;
+    uint64_t stringsOffset;
+};
+
+struct PackEntry
+{
+    uint64_t hash;
+    uint64_t offset;        // From the start of the pack
+    uint32_t storedSize;    // Bytes in the pack, which differs from size for compressed entries
+    uint32_t size;
+    uint32_t checksum;      // CRC32 of the uncompressed data
+    uint32_t flags;
+    uint32_t pathOffset;    // From the start of the string table
+    uint32_t pathLength;
+};
+
+static_assert(sizeof(PackHeader) == 32, "PackHeader must not contain padding");
+static_assert(sizeof(PackEntry) == 40, "PackEntry must not contain padding");
+
+// Forward slashes, no leading "./" or "/"
+// Rooted paths ("/...", "\\..." or with a drive letter) aren't relative to the packs or override directories
+inline bool IsAbsolutePath(const std::string& path)
+{
+    if (!path.empty() && (path[0] == '/' || path[0] == '\\'))
+        return true;
+    return path.size() >= 2 && path[1] == ':' && ((path[0] >= 'a' && path[0] <= 'z') || (path[0] >= 'A' && path[0] <= 'Z'));
+}
+
+// Uses forward slashes and folds "." and ".." segments, so every spelling of a path maps to the same string.
+// Absolute paths keep their root, ".." segments that climb above a relative path's start are kept.
+inline std::string NormalizePath(const std::string& path)
+{
+    std::string result;
+    size_t start = 0;
+    if (IsAbsolutePath(path)) {
+        if (path[0] != '/' && path[0] != '\\') {
+            result = path.substr(0, 2);
+            start = 2;
+        }
+        if (start < path.size() && (path[start] == '/' || path[start] == '\\'))
+            result += '/';
+    }
+    size_t root = result.size();
+
+    while (start < path.size()) {
+        size_t end = path.find_first_of("/\\", start);
+        if (end == std::string::npos)
+            end = path.size();
+        std::string segment = path.substr(start, end - start);
+        start = end + 1;
+
+        if (segment.empty() || segment == ".")
+            continue;
+        if (segment == "..") {
+            size_t last = result.find_last_of('/');
+            last = last == std::string::npos || last < root ? root : last + 1;
+            if (result.size() > root && result.compare(last, std::string::npos, "..") != 0) {
+                result.erase(last > root ? last - 1 : root);
+                continue;
+            }
+            if (root > 0)
+                continue;
+        }
+        if (result.size() > root)
+            result += '/';
+        result += segment;
+    }
+    return result;
+}
+
+inline uint64_t HashPath(const std::string& normalizedPath)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : normalizedPath) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline uint32_t Crc32(const unsigned char* data, size_t size)
+{
+    struct Table
+    {
+        uint32_t values[256];
+        Table()
+        {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                values[i] = c;
+            }
+        }
+    };
+    static const Table table;
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++)
+        crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// A mounted pack file. The whole file is mapped and the index is used in place.
+class PackFile
+{
+public:
+    bool Open(const char* path)
+    {
+        if (!file.Open(path))
+            return false;
+
+        ByteView view = file.getView();
+        if (view.size < sizeof(PackHeader)) {
+            std::cerr << "ERROR: " << path << " is too small to be a pack\n";
+            return false;
+        }
+        header = (const PackHeader*)view.data;
+        if (header->magic != PACK_MAGIC || header->version != PACK_VERSION) {
+            std::cerr << "ERROR: " << path << " is not a supported pack file\n";
+            return false;
+        }
+        // The index is read in place, so it has to be aligned as well as inside the file
+        if (header->indexOffset > view.size || (uint64_t)header->entryCount * sizeof(PackEntry) > view.size - header->indexOffset ||
+            header->stringsOffset > view.size || header->indexOffset % alignof(PackEntry) != 0) {
+            std::cerr << "ERROR: Pack index of " << path << " is out of bounds\n";
+            return false;
+        }
+
+        entries = (const PackEntry*)(view.data + header->indexOffset);
+        strings = (const char*)(view.data + header->stringsOffset);
+        stringsSize = view.size - (size_t)header->stringsOffset;
+        for (uint32_t i = 0; i < header->entryCount; i++) {
+            const PackEntry& entry = entries[i];
+            if (entry.offset > view.size || entry.storedSize > view.size - entry.offset || (uint64_t)entry.pathOffset + entry.pathLength > stringsSize) {
+                std::cerr << "ERROR: Entry " << i << " of " << path << " is out of bounds\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Binary searches the index. Returns null when the path isn't in the pack.
+    const PackEntry* Find(const std::string& normalizedPath) const
+    {
+        uint64_t hash = HashPath(normalizedPath);
+        const PackEntry* end = entries + header->entryCount;
+        const PackEntry* it = std::lower_bound(entries, end, hash, [](const PackEntry& entry, uint64_t value) { return entry.hash < value; });
+        for (; it != end && it->hash == hash; ++it)
+            if (it->pathLength == normalizedPath.size() && memcmp(strings + it->pathOffset, normalizedPath.data(), it->pathLength) == 0)
+                return it;
+        return nullptr;
+    }
+
+    // Raw bytes as stored in the pack
+    ByteView getStoredData(const PackEntry& entry) const
+    {
+        return ByteView(file.getView().data + entry.offset, entry.storedSize);
+    }
+
+    std::string getPath(const PackEntry& entry) const { return std::string(strings + entry.pathOffset, entry.pathLength); }
+
+    uint32_t getEntryCount() const { return header->entryCount; }
+    const PackEntry& getEntry(uint32_t index) const { return entries[index]; }
+
+private:
+    MappedFile file;
+    const PackHeader* header = nullptr;
+    const PackEntry* entries = nullptr;
+    const char* strings = nullptr;
+    size_t stringsSize = 0;
+};
+
+// Builds pack files. Used by the PackBuilder tool.
+class PackWriter
+{
+public:
+    PackWriter(uint32_t _alignment = 16) : alignment(std::max(1u, _alignment)) {}
+
+    // Adds a file under the given path. Compression is only kept when it actually saves space.
+    void Add(const std::string& path, std::vector<unsigned char> data, bool compress = false)
+    {
+        Pending file;
+        file.path = NormalizePath(path);
+        file.size = (uint32_t)data.size();
+        file.checksum = Crc32(data.empty() ? nullptr : &data[0], data.size());
+        file.flags = 0;
+
+#ifdef NGE_USE_LZ4
+        if (compress && !data.empty()) {
+            std::vector<unsigned char> compressed(LZ4_compressBound((int)data.size()));
+            int written = LZ4_compress_default((const char*)&data[0], (char*)&compressed[0], (int)data.size(), (int)compressed.size());
+            if (written > 0 && (size_t)written < data.size()) {
+                compressed.resize(written);
+                data.swap(compressed);
+                file.flags |= PACK_ENTRY_LZ4;
+            }
+        }
+#else
+        (void)compress;
+#endif
+        file.data = std::move(data);
+        files.push_back(std::move(file));
+    }
+
+    bool Write(const char* path)
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "ERROR: Could not create " << path << "\n";
+            return false;
+        }
+
+        std::vector<PackEntry> entries;
+        std::string strings;
+        uint64_t offset = Align(sizeof(PackHeader));
+        for (const Pending& file : files) {
+            PackEntry entry;
+            entry.hash = HashPath(file.path);
+            entry.offset = offset;
+            entry.storedSize = (uint32_t)file.data.size();
+            entry.size = file.size;
+            entry.checksum = file.checksum;
+            entry.flags = file.flags;
+            entry.pathOffset = (uint32_t)strings.size();
+            entry.pathLength = (uint32_t)file.path.size();
+            entries.push_back(entry);
+
+            strings += file.path;
+            offset = Align(offset + file.data.size());
+        }
+
+        PackHeader header;
+        header.magic = PACK_MAGIC;
+        header.version = PACK_VERSION;
+        header.entryCount = (uint32_t)entries.size();
+        header.alignment = alignment;
+        header.indexOffset = (offset + 7) & ~(uint64_t)7;
+        header.stringsOffset = header.indexOffset + entries.size() * sizeof(PackEntry);
+
+        WritePadded(out, &header, sizeof(header), entries.empty() ? header.indexOffset : entries[0].offset);
+        for (size_t i = 0; i < files.size(); i++) {
+            uint64_t next = i + 1 < files.size() ? entries[i + 1].offset : header.indexOffset;
+            WritePadded(out, files[i].data.empty() ? nullptr : &files[i].data[0], files[i].data.size(), next - entries[i].offset);
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const PackEntry& a, const PackEntry& b) { return a.hash < b.hash; });
+        out.write((const char*)entries.data(), entries.size() * sizeof(PackEntry));
+        out.write(strings.data(), strings.size());
+        return out.good();
+    }
+
+    size_t getFileCount() const { return files.size(); }
+
+private:
+    struct Pending
+    {
+        std::string path;
+        std::vector<unsigned char> data;
+        uint32_t size;
+        uint32_t checksum;
+        uint32_t flags;
+    };
+
+    uint32_t alignment;
+    std::vector<Pending> files;
+
+    uint64_t Align(uint64_t offset) const { return (offset + alignment - 1) / alignment * alignment; }
+
+    static void WritePadded(std::ofstream& out, const void* data, size_t size, uint64_t paddedSize)
+    {
+        if (size)
+            out.write((const char*)data, size);
+        static const char zeros[4096] = {};
+        for (uint64_t left = paddedSize - size; left > 0;) {
+            size_t chunk = (size_t)std::min<uint64_t>(left, sizeof(zeros));
+            out.write(zeros, chunk);
+            left -= chunk;
+        }
+    }
+};
+
+// Engine wide file access. Paths are looked up in the override directories first (loose files, handy while
+// developing), then in the mounted packs, most recently mounted first. Data is returned as views into mapped memory,
+// so nothing is copied unless an entry is compressed.
+class VirtualFileSystem
+{
+public:
+    static VirtualFileSystem& Get()
+    {
+        static VirtualFileSystem instance;
+        return instance;
+    }
+
+    bool Mount(const char* packPath)
+    {
+        std::unique_ptr<PackFile> pack(new PackFile());
+        if (!pack->Open(packPath))
+            return false;
+        packs.insert(packs.begin(), std::move(pack));
+        return true;
+    }
+
+    // Loose files under this directory take priority over the packs. "" is the working directory.
+    void AddOverrideDirectory(const std::string& directory)
+    {
+        // Not normalized like pack paths, absolute directories have to keep their leading slash
+        std::string normalized = directory;
+        std::replace(normalized.begin(), normalized.end(), '\\', '/');
+        if (!normalized.empty() && normalized.back() != '/')
+            normalized += '/';
+        overrideDirectories.push_back(normalized);
+    }
+
+    // Returns the contents of the file, or an empty view (that is false) if it doesn't exist. Absolute paths are
+    // read straight from disk. A view of a loose file only stays valid until the same file is read again after it
+    // changed, so copy out what has to be kept.
+    ByteView Read(const std::string& path)
+    {
+        if (IsAbsolutePath(path))
+            return ReadLoose(path);
+
+        std::string normalized = NormalizePath(path);
+
+        for (const std::string& directory : overrideDirectories) {
+            ByteView view = ReadLoose(directory + normalized);
+            if (view)
+                return view;
+        }
+
+        for (const std::unique_ptr<PackFile>& pack : packs) {
+            const PackEntry* entry = pack->Find(normalized);
+            if (entry)
+                return ReadEntry(*pack, *entry, normalized);
+        }
+        return ByteView();
+    }
+
+    bool Exists(const std::string& path) { return (bool)Read(path); }
+
+    // Checks every entry of every mounted pack against its checksum. Returns false if any of them is damaged.
+    bool VerifyAll()
+    {
+        bool valid = true;
+        for (const std::unique_ptr<PackFile>& pack : packs)
+            for (uint32_t i = 0; i < pack->getEntryCount(); i++)
+                valid = (bool)ReadEntry(*pack, pack->getEntry(i), pack->getPath(pack->getEntry(i)), true) && valid;
+        return valid;
+    }
+
+    // Drops loose file copies and decompressed data. Views handed out before are no longer valid.
+    void ReleaseCache()
+    {
+        looseFiles.clear();
+        decompressed.clear();
+        verified.clear();
+    }
+
+    void UnmountAll()
+    {
+        ReleaseCache();
+        packs.clear();
+    }
+
+private:
+    std::vector<std::unique_ptr<PackFile>> packs;
+    std::vector<std::string> overrideDirectories;
+    struct LooseFile
+    {
+        FileStamp stamp;
+        std::vector<unsigned char> data;
+    };
+
+    std::unordered_map<std::string, LooseFile> looseFiles;
+    std::unordered_map<const PackEntry*, std::vector<unsigned char>> decompressed;
+    std::unordered_set<const PackEntry*> verified;
+
+    VirtualFileSystem() {}
+
+    // Loose files are copied and closed right away instead of staying mapped, so they can still be edited while the
+    // engine runs. The copy is read again whenever the file's size or modification time changes.
+    ByteView ReadLoose(const std::string& path)
+    {
+        FileStamp stamp;
+        if (!getFileStamp(path.c_str(), stamp))
+            return ByteView();
+
+        auto it = looseFiles.find(path);
+        if (it == looseFiles.end() || it->second.stamp != stamp) {
+            MappedFile file;
+            if (!file.Open(path.c_str()))
+                return ByteView();
+            ByteView mapped = file.getView();
+
+            LooseFile& loose = looseFiles[path];
+            loose.stamp = stamp;
+            loose.data.assign(mapped.begin(), mapped.end());
+            it = looseFiles.find(path);
+        }
+
+        const std::vector<unsigned char>& data = it->second.data;
+        return ByteView(data.empty() ? (const unsigned char*)"" : data.data(), data.size());
+    }
+
+    ByteView ReadEntry(const PackFile& pack, const PackEntry& entry, const std::string& path, bool verify = false)
+    {
+        ByteView stored = pack.getStoredData(entry);
+        ByteView data = stored;
+
+        if (entry.flags & PACK_ENTRY_LZ4) {
+            auto it = decompressed.find(&entry);
+            if (it == decompressed.end()) {
+#ifdef NGE_USE_LZ4
+                std::vector<unsigned char> buffer(entry.size);
+                int read = LZ4_decompress_safe((const char*)stored.data, (char*)buffer.data(), (int)stored.size, (int)buffer.size());
+                if (read != (int)entry.size) {
+                    std::cerr << "ERROR: Could not decompress " << path << "\n";
+                    return ByteView();
+                }
+                it = decompressed.emplace(&entry, std::move(buffer)).first;
+#else
+                std::cerr << "ERROR: " << path << " is compressed, but the engine was built without NGE_USE_LZ4\n";
+                return ByteView();
+#endif
+            }
+            data = ByteView(it->second.data(), it->second.size());
+        }
+
+        // Entries are checked once: always when decompressing, otherwise only on request or in debug builds so
+        // that reading stays free
+        #ifdef _DEBUG
+            verify = true;
+        #endif
+        if ((verify || (entry.flags & PACK_ENTRY_LZ4)) && !verified.count(&entry)) {
+            if (Crc32(data.data, data.size) != entry.checksum) {
+                std::cerr << "ERROR: Checksum mismatch for " << path << "\n";
+                return ByteView();
+            }
+            verified.insert(&entry);
+        }
+        return data;
+    }
+};
+
+#endif
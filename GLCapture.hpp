@@ -0,0 +1,1211 @@
+#ifndef _H_GL_CAPTURE_
+#define _H_GL_CAPTURE_
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <initializer_list>
+#include <iostream>
+#include <fstream>
+#include <string.h>
+#include <stdint.h>
+
+// ===================== Trace format =====================
+//
+// [TraceHeader] [prologue records] [frame records]
+//
+// Every record is: uint16 op, uint16 argument count, uint32 blob size, the uint32 arguments, then the blob padded to
+// 4 bytes. The prologue recreates every object and piece of state that was alive when the frame started, the frame
+// holds every recorded call between two buffer swaps. Calls that depend on a binding (uploads, uniforms, attribute
+// pointers...) are stored with the object they applied to, so the prologue doesn't need the binds in between.
+
+const uint32_t TRACE_MAGIC = 0x5445474E; // "NGET"
+const uint32_t TRACE_VERSION = 1;
+
+struct TraceHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;             // Size of the default framebuffer when the frame was captured
+    uint32_t height;
+    uint32_t prologueCount;     // Number of records
+    uint32_t frameCount;
+};
+
+enum TraceOp {
+    TRACE_GEN_BUFFER,               // name
+    TRACE_GEN_TEXTURE,              // name
+    TRACE_GEN_VERTEX_ARRAY,         // name
+    TRACE_GEN_FRAMEBUFFER,          // name
+    TRACE_GEN_RENDERBUFFER,         // name
+    TRACE_CREATE_SHADER,            // name, type
+    TRACE_CREATE_PROGRAM,           // name
+    TRACE_DELETE_BUFFER,            // name
+    TRACE_DELETE_TEXTURE,           // name
+    TRACE_DELETE_VERTEX_ARRAY,      // name
+    TRACE_DELETE_FRAMEBUFFER,       // name
+    TRACE_DELETE_RENDERBUFFER,      // name
+    TRACE_DELETE_SHADER,            // name
+    TRACE_DELETE_PROGRAM,           // name
+    TRACE_SHADER_SOURCE,            // shader, blob: source
+    TRACE_SHADER_BINARY,            // shader, format, blob: binary
+    TRACE_SPECIALIZE_SHADER,        // shader, constant count, blob: entry point, 0, indices, values
+    TRACE_COMPILE_SHADER,           // shader
+    TRACE_ATTACH_SHADER,            // program, shader
+    TRACE_DETACH_SHADER,            // program, shader
+    TRACE_LINK_PROGRAM,             // program
+    TRACE_GET_UNIFORM_LOCATION,     // program, location, blob: name
+    TRACE_USE_PROGRAM,              // program
+    TRACE_UNIFORM_1I,               // program, location, value
+    TRACE_UNIFORM_1F,               // program, location, value
+    TRACE_UNIFORM_2F,               // program, location, values...
+    TRACE_UNIFORM_3F,
+    TRACE_UNIFORM_4F,
+    TRACE_UNIFORM_2FV,              // program, location, count, blob: values
+    TRACE_UNIFORM_3FV,
+    TRACE_UNIFORM_4FV,
+    TRACE_UNIFORM_MATRIX_2FV,       // program, location, count, transpose, blob: values
+    TRACE_UNIFORM_MATRIX_3FV,
+    TRACE_UNIFORM_MATRIX_4FV,
+    TRACE_BIND_BUFFER,              // target, buffer
+    TRACE_BUFFER_DATA,              // buffer, target, size, usage, blob: data (empty for NULL)
+    TRACE_BUFFER_SUB_DATA,          // buffer, offset, size, target, blob: data
+    TRACE_ELEMENT_BUFFER,           // vertex array, buffer
+    TRACE_ACTIVE_TEXTURE,           // unit
+    TRACE_BIND_TEXTURE,             // target, texture
+    TRACE_TEX_IMAGE_2D,             // texture, target, level, internal format, width, height, format, type, unpack alignment, blob: pixels
+    TRACE_TEX_PARAMETER_I,          // texture, parameter, target, value
+    TRACE_GENERATE_MIPMAP,          // texture, target
+    TRACE_TEX_BUFFER,               // texture, target, internal format, buffer
+    TRACE_BIND_VERTEX_ARRAY,        // vertex array
+    TRACE_VERTEX_ATTRIB_POINTER,    // vertex array, index, buffer, size, type, normalized, stride, offset
+    TRACE_ENABLE_VERTEX_ATTRIB,     // vertex array, index
+    TRACE_DISABLE_VERTEX_ATTRIB,    // vertex array, index
+    TRACE_BIND_FRAMEBUFFER,         // target, framebuffer
+    TRACE_BIND_RENDERBUFFER,        // target, renderbuffer
+    TRACE_FRAMEBUFFER_TEXTURE_2D,   // framebuffer, attachment, target, texture target, texture, level
+    TRACE_FRAMEBUFFER_RENDERBUFFER, // framebuffer, attachment, target, renderbuffer target, renderbuffer
+    TRACE_RENDERBUFFER_STORAGE,     // renderbuffer, target, internal format, width, height
+    TRACE_BLIT_FRAMEBUFFER,         // source rectangle, destination rectangle, mask, filter
+    TRACE_ENABLE,                   // capability
+    TRACE_DISABLE,                  // capability
+    TRACE_VIEWPORT,                 // x, y, width, height
+    TRACE_SCISSOR,                  // x, y, width, height
+    TRACE_CLEAR_COLOR,              // r, g, b, a as float bits
+    TRACE_DEPTH_FUNC,               // function
+    TRACE_BLEND_FUNC,               // source, destination
+    TRACE_CULL_FACE,                // face
+    TRACE_POLYGON_MODE,             // face, mode
+    TRACE_CLEAR,                    // mask
+    TRACE_DRAW_ARRAYS,              // mode, first, count
+    TRACE_DRAW_ARRAYS_INSTANCED,    // mode, first, count, instances
+    TRACE_DRAW_ELEMENTS,            // mode, count, type, offset
+    TRACE_DRAW_ELEMENTS_INSTANCED,  // mode, count, type, offset, instances
+    TRACE_OP_COUNT
+};
+
+// Object name spaces, used to remap names on replay and to drop records of deleted objects
+enum TraceNamespace {
+    TRACE_NS_NONE,
+    TRACE_NS_BUFFER,
+    TRACE_NS_BUFFER_CONTENT,    // Uploads into a buffer, replaced as a whole by glBufferData
+    TRACE_NS_TEXTURE,
+    TRACE_NS_VERTEX_ARRAY,
+    TRACE_NS_FRAMEBUFFER,
+    TRACE_NS_RENDERBUFFER,
+    TRACE_NS_PROGRAM,           // Programs and shaders share their names
+    TRACE_NS_COUNT
+};
+
+enum TraceOpFlags {
+    TRACE_TRANSIENT = 1 << 0,   // Binds and draws, only needed inside the captured frame
+    TRACE_STATE = 1 << 1,       // Global state, repeated at the start of the frame so every replayed loop starts the same
+    TRACE_DELETE = 1 << 2,      // Drops everything recorded for the object from the prologue
+};
+
+struct TraceOpInfo
+{
+    const char* name;
+    int keyArgs;            // Leading arguments that identify the state a call sets, later calls replace earlier ones. -1 never replaces.
+    int keyClass;           // Ops of the same class replace each other, e.g. glEnable and glDisable
+    TraceNamespace object;  // Namespace of the first argument
+    int flags;
+};
+
+inline const TraceOpInfo& getTraceOpInfo(int op)
+{
+    static const TraceOpInfo info[TRACE_OP_COUNT] = {
+        { "glGenBuffers", -1, TRACE_GEN_BUFFER, TRACE_NS_BUFFER, 0 },
+        { "glGenTextures", -1, TRACE_GEN_TEXTURE, TRACE_NS_TEXTURE, 0 },
+        { "glGenVertexArrays", -1, TRACE_GEN_VERTEX_ARRAY, TRACE_NS_VERTEX_ARRAY, 0 },
+        { "glGenFramebuffers", -1, TRACE_GEN_FRAMEBUFFER, TRACE_NS_FRAMEBUFFER, 0 },
+        { "glGenRenderbuffers", -1, TRACE_GEN_RENDERBUFFER, TRACE_NS_RENDERBUFFER, 0 },
+        { "glCreateShader", -1, TRACE_CREATE_SHADER, TRACE_NS_PROGRAM, 0 },
+        { "glCreateProgram", -1, TRACE_CREATE_PROGRAM, TRACE_NS_PROGRAM, 0 },
+        { "glDeleteBuffers", -1, TRACE_DELETE_BUFFER, TRACE_NS_BUFFER, TRACE_DELETE },
+        { "glDeleteTextures", -1, TRACE_DELETE_TEXTURE, TRACE_NS_TEXTURE, TRACE_DELETE },
+        { "glDeleteVertexArrays", -1, TRACE_DELETE_VERTEX_ARRAY, TRACE_NS_VERTEX_ARRAY, TRACE_DELETE },
+        { "glDeleteFramebuffers", -1, TRACE_DELETE_FRAMEBUFFER, TRACE_NS_FRAMEBUFFER, TRACE_DELETE },
+        { "glDeleteRenderbuffers", -1, TRACE_DELETE_RENDERBUFFER, TRACE_NS_RENDERBUFFER, TRACE_DELETE },
+        // Shaders stay in the prologue after deletion, programs linked from them still need them on replay
+        { "glDeleteShader", -1, TRACE_DELETE_SHADER, TRACE_NS_PROGRAM, 0 },
+        { "glDeleteProgram", -1, TRACE_DELETE_PROGRAM, TRACE_NS_PROGRAM, TRACE_DELETE },
+        { "glShaderSource", 1, TRACE_SHADER_SOURCE, TRACE_NS_PROGRAM, 0 },
+        { "glShaderBinary", 1, TRACE_SHADER_BINARY, TRACE_NS_PROGRAM, 0 },
+        { "glSpecializeShader", 1, TRACE_SPECIALIZE_SHADER, TRACE_NS_PROGRAM, 0 },
+        { "glCompileShader", 1, TRACE_COMPILE_SHADER, TRACE_NS_PROGRAM, 0 },
+        { "glAttachShader", 2, TRACE_ATTACH_SHADER, TRACE_NS_PROGRAM, 0 },
+        { "glDetachShader", 2, TRACE_DETACH_SHADER, TRACE_NS_PROGRAM, 0 },
+        { "glLinkProgram", 1, TRACE_LINK_PROGRAM, TRACE_NS_PROGRAM, 0 },
+        { "glGetUniformLocation", 2, TRACE_GET_UNIFORM_LOCATION, TRACE_NS_PROGRAM, 0 },
+        { "glUseProgram", -1, TRACE_USE_PROGRAM, TRACE_NS_NONE, TRACE_TRANSIENT },
+        // Every uniform call replaces the value at its location, whatever the type
+        { "glUniform1i", 2, TRACE_UNIFORM_1I, TRACE_NS_PROGRAM, 0 },
+        { "glUniform1f", 2, TRACE_UNIFORM_1I, TRACE_NS_PROGRAM, 0 },
+        { "glUniform2f", 2, TRACE_UNIFORM_1I, TRACE_NS_PROGRAM, 0 },
+        { "glUniform3f", 2, TRACE_UNIFORM_1I, TRACE_NS_PROGRAM, 0 },
+        { "glUniform4f", 2, TRACE_UNIFORM_1I, TRACE_NS_PROGRAM, 0 },
+        { "glUniform2fv", 2, TRACE_UNIFORM_1I, TRACE_NS_PROGRAM, 0 },
+        { "glUniform3fv", 2, TRACE_UNIFORM_1I, TRACE_NS_PROGRAM, 0 },
+        { "glUniform4fv", 2, TRACE_UNIFORM_1I, TRACE_NS_PROGRAM, 0 },
+        { "glUniformMatrix2fv", 2, TRACE_UNIFORM_1I, TRACE_NS_PROGRAM, 0 },
+        { "glUniformMatrix3fv", 2, TRACE_UNIFORM_1I, TRACE_NS_PROGRAM, 0 },
+        { "glUniformMatrix4fv", 2, TRACE_UNIFORM_1I, TRACE_NS_PROGRAM, 0 },
+        { "glBindBuffer", -1, TRACE_BIND_BUFFER, TRACE_NS_NONE, TRACE_TRANSIENT },
+        { "glBufferData", -1, TRACE_BUFFER_DATA, TRACE_NS_BUFFER_CONTENT, 0 },
+        { "glBufferSubData", 3, TRACE_BUFFER_SUB_DATA, TRACE_NS_BUFFER_CONTENT, 0 },
+        { "glBindBuffer(GL_ELEMENT_ARRAY_BUFFER)", 1, TRACE_ELEMENT_BUFFER, TRACE_NS_VERTEX_ARRAY, 0 },
+        { "glActiveTexture", -1, TRACE_ACTIVE_TEXTURE, TRACE_NS_NONE, TRACE_TRANSIENT },
+        { "glBindTexture", -1, TRACE_BIND_TEXTURE, TRACE_NS_NONE, TRACE_TRANSIENT },
+        { "glTexImage2D", 3, TRACE_TEX_IMAGE_2D, TRACE_NS_TEXTURE, 0 },
+        { "glTexParameteri", 2, TRACE_TEX_PARAMETER_I, TRACE_NS_TEXTURE, 0 },
+        { "glGenerateMipmap", 1, TRACE_GENERATE_MIPMAP, TRACE_NS_TEXTURE, 0 },
+        { "glTexBuffer", 1, TRACE_TEX_BUFFER, TRACE_NS_TEXTURE, 0 },
+        { "glBindVertexArray", -1, TRACE_BIND_VERTEX_ARRAY, TRACE_NS_NONE, TRACE_TRANSIENT },
+        { "glVertexAttribPointer", 2, TRACE_VERTEX_ATTRIB_POINTER, TRACE_NS_VERTEX_ARRAY, 0 },
+        { "glEnableVertexAttribArray", 2, TRACE_ENABLE_VERTEX_ATTRIB, TRACE_NS_VERTEX_ARRAY, 0 },
+        { "glDisableVertexAttribArray", 2, TRACE_ENABLE_VERTEX_ATTRIB, TRACE_NS_VERTEX_ARRAY, 0 },
+        { "glBindFramebuffer", -1, TRACE_BIND_FRAMEBUFFER, TRACE_NS_NONE, TRACE_TRANSIENT },
+        { "glBindRenderbuffer", -1, TRACE_BIND_RENDERBUFFER, TRACE_NS_NONE, TRACE_TRANSIENT },
+        { "glFramebufferTexture2D", 2, TRACE_FRAMEBUFFER_TEXTURE_2D, TRACE_NS_FRAMEBUFFER, 0 },
+        { "glFramebufferRenderbuffer", 2, TRACE_FRAMEBUFFER_TEXTURE_2D, TRACE_NS_FRAMEBUFFER, 0 },
+        { "glRenderbufferStorage", 1, TRACE_RENDERBUFFER_STORAGE, TRACE_NS_RENDERBUFFER, 0 },
+        { "glBlitFramebuffer", -1, TRACE_BLIT_FRAMEBUFFER, TRACE_NS_NONE, TRACE_TRANSIENT },
+        { "glEnable", 1, TRACE_ENABLE, TRACE_NS_NONE, TRACE_STATE },
+        { "glDisable", 1, TRACE_ENABLE, TRACE_NS_NONE, TRACE_STATE },
+        { "glViewport", 0, TRACE_VIEWPORT, TRACE_NS_NONE, TRACE_STATE },
+        { "glScissor", 0, TRACE_SCISSOR, TRACE_NS_NONE, TRACE_STATE },
+        { "glClearColor", 0, TRACE_CLEAR_COLOR, TRACE_NS_NONE, TRACE_STATE },
+        { "glDepthFunc", 0, TRACE_DEPTH_FUNC, TRACE_NS_NONE, TRACE_STATE },
+        { "glBlendFunc", 0, TRACE_BLEND_FUNC, TRACE_NS_NONE, TRACE_STATE },
+        { "glCullFace", 0, TRACE_CULL_FACE, TRACE_NS_NONE, TRACE_STATE },
+        { "glPolygonMode", 1, TRACE_POLYGON_MODE, TRACE_NS_NONE, TRACE_STATE },
+        { "glClear", -1, TRACE_CLEAR, TRACE_NS_NONE, TRACE_TRANSIENT },
+        { "glDrawArrays", -1, TRACE_DRAW_ARRAYS, TRACE_NS_NONE, TRACE_TRANSIENT },
+        { "glDrawArraysInstanced", -1, TRACE_DRAW_ARRAYS_INSTANCED, TRACE_NS_NONE, TRACE_TRANSIENT },
+        { "glDrawElements", -1, TRACE_DRAW_ELEMENTS, TRACE_NS_NONE, TRACE_TRANSIENT },
+        { "glDrawElementsInstanced", -1, TRACE_DRAW_ELEMENTS_INSTANCED, TRACE_NS_NONE, TRACE_TRANSIENT },
+    };
+    return info[op];
+}
+
+// Bytes per pixel of client side pixel data
+inline size_t getPixelSize(GLenum format, GLenum type)
+{
+    switch (type) {
+    case GL_UNSIGNED_INT_24_8:
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_8_8_8_8:
+    case GL_UNSIGNED_INT_8_8_8_8_REV:
+    case GL_UNSIGNED_INT_10F_11F_11F_REV:
+        return 4;
+    case GL_UNSIGNED_SHORT_5_6_5:
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+        return 2;
+    }
+
+    size_t components = 4;
+    switch (format) {
+    case GL_RED: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: case GL_STENCIL_INDEX: components = 1; break;
+    case GL_RG: case GL_RG_INTEGER: case GL_DEPTH_STENCIL: components = 2; break;
+    case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: components = 3; break;
+    }
+
+    switch (type) {
+    case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: return components * 2;
+    case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT: return components * 4;
+    default: return components;
+    }
+}
+
+// ===================== Capture =====================
+
+// Records GL calls by swapping glad's function pointers for recording wrappers. Install it right after loading GL so
+// that every object is seen from its creation. While installed it keeps a compact prologue of everything needed to
+// recreate the current objects and state; RequestCapture then writes that prologue plus the next full frame to a
+// trace, which tools/GLReplay can play back without the game.
+class GLCapture
+{
+public:
+    static GLCapture& Get()
+    {
+        static GLCapture instance;
+        return instance;
+    }
+
+    void Install();
+    void Uninstall();
+    bool isInstalled() const { return installed; }
+
+    // Captures the frame after the next EndFrame, width and height are the size of the default framebuffer
+    void RequestCapture(const std::string& _path, int width, int height)
+    {
+        if (!installed || state != CAPTURE_IDLE)
+            return;
+        path = _path;
+        header.width = (uint32_t)width;
+        header.height = (uint32_t)height;
+        state = CAPTURE_REQUESTED;
+    }
+
+    // Call right after swapping buffers
+    void EndFrame()
+    {
+        if (state == CAPTURE_REQUESTED) {
+            frame.clear();
+            state = BeginWrite() ? CAPTURE_FRAME : CAPTURE_IDLE;
+            if (state == CAPTURE_FRAME)
+                RecordFrameStart();
+        }
+        else if (state == CAPTURE_FRAME) {
+            FinishWrite();
+            frame.clear();
+            state = CAPTURE_IDLE;
+        }
+    }
+
+    bool isCapturing() const { return state != CAPTURE_IDLE; }
+
+private:
+    struct Record
+    {
+        uint16_t op;
+        uint16_t argCount;
+        uint32_t args[10];
+        std::vector<unsigned char> blob;
+        uint64_t key;
+        uint64_t object;
+        bool live;
+    };
+
+    enum CaptureState { CAPTURE_IDLE, CAPTURE_REQUESTED, CAPTURE_FRAME };
+
+    bool installed = false;
+    CaptureState state = CAPTURE_IDLE;
+    std::string path;
+    std::ofstream out;
+    TraceHeader header = {};
+
+    std::vector<Record> prologue;
+    std::vector<Record> frame;
+    size_t deadRecords = 0;
+    std::unordered_map<uint64_t, size_t> latest;                // Key of a state setting call -> prologue index
+    std::unordered_map<uint64_t, std::vector<size_t>> objects;  // Object -> prologue indices that refer to it
+    std::unordered_map<GLuint, uint32_t> generations;            // Times a shader or program name was created
+
+    // Bindings at the moment, restored at the start of the captured frame
+    GLuint program = 0, vertexArray = 0, readFramebuffer = 0, drawFramebuffer = 0, renderbuffer = 0;
+    GLenum activeTexture = GL_TEXTURE0;
+    std::unordered_map<GLenum, GLuint> buffers;                 // Target -> buffer, without GL_ELEMENT_ARRAY_BUFFER which belongs to the vertex array
+    std::unordered_map<uint64_t, GLuint> textures;              // (unit, target) -> texture
+
+    GLCapture() {}
+    GLCapture(const GLCapture&) = delete;
+    GLCapture& operator=(const GLCapture&) = delete;
+
+    static uint32_t Bits(float value) { uint32_t bits; memcpy(&bits, &value, 4); return bits; }
+    static uint64_t ObjectKey(int ns, GLuint name) { return ((uint64_t)ns << 32) | name; }
+
+    // Shader and program names are handed out again once deleted, and shader records outlive the shader, so the
+    // generation of the name tells the old and the new object apart
+    uint32_t getGeneration(GLuint name) const
+    {
+        auto it = generations.find(name);
+        return it == generations.end() ? 0 : it->second;
+    }
+
+    uint64_t getObjectKey(int ns, GLuint name) const
+    {
+        return ns == TRACE_NS_PROGRAM ? ObjectKey(ns, name) | ((uint64_t)getGeneration(name) << 40) : ObjectKey(ns, name);
+    }
+    static uint64_t TextureKey(GLenum unit, GLenum target) { return ((uint64_t)unit << 32) | target; }
+
+    // Cube map faces are uploaded one by one but bound as a whole
+    static GLenum getBindingTarget(GLenum target)
+    {
+        return target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z ? GL_TEXTURE_CUBE_MAP : target;
+    }
+
+    GLuint getBoundTexture(GLenum target) const
+    {
+        auto it = textures.find(TextureKey(activeTexture, getBindingTarget(target)));
+        return it == textures.end() ? 0 : it->second;
+    }
+
+    GLuint getBoundBuffer(GLenum target) const
+    {
+        auto it = buffers.find(target);
+        return it == buffers.end() ? 0 : it->second;
+    }
+
+    GLuint getBoundFramebuffer(GLenum target) const { return target == GL_READ_FRAMEBUFFER ? readFramebuffer : drawFramebuffer; }
+
+    void Add(TraceOp op, std::initializer_list<uint32_t> args, const void* blob = nullptr, size_t blobSize = 0)
+    {
+        Record record;
+        record.op = (uint16_t)op;
+        record.argCount = (uint16_t)args.size();
+        std::copy(args.begin(), args.end(), record.args);
+        if (blobSize)
+            record.blob.assign((const unsigned char*)blob, (const unsigned char*)blob + blobSize);
+        record.key = 0;
+        record.object = 0;
+        record.live = true;
+
+        // Calls of the captured frame still update the prologue, later captures need what they create and set
+        if (state == CAPTURE_FRAME)
+            frame.push_back(record);
+
+        const TraceOpInfo& info = getTraceOpInfo(op);
+        if (info.flags & TRACE_TRANSIENT)
+            return;
+        if (op == TRACE_CREATE_SHADER || op == TRACE_CREATE_PROGRAM)
+            generations[record.args[0]]++;
+        if (info.flags & TRACE_DELETE) {
+            Forget(info.object, record.args[0]);
+            if (info.object == TRACE_NS_BUFFER)
+                Forget(TRACE_NS_BUFFER_CONTENT, record.args[0]);
+            return;
+        }
+        // glBufferData replaces everything uploaded to the buffer before
+        if (op == TRACE_BUFFER_DATA)
+            Forget(TRACE_NS_BUFFER_CONTENT, record.args[0]);
+
+        size_t index = prologue.size();
+        if (info.keyArgs >= 0) {
+            uint64_t key = 14695981039346656037ull ^ (uint64_t)info.keyClass;
+            for (int i = 0; i < info.keyArgs; i++)
+                key = (key * 1099511628211ull) ^ record.args[i];
+            if (info.object == TRACE_NS_PROGRAM)
+                key = (key * 1099511628211ull) ^ getGeneration(record.args[0]);
+            record.key = key;
+
+            auto it = latest.find(key);
+            if (it != latest.end()) {
+                Kill(it->second);
+                it->second = index;
+            }
+            else {
+                latest[key] = index;
+            }
+        }
+        if (info.object != TRACE_NS_NONE) {
+            record.object = getObjectKey(info.object, record.args[0]);
+            objects[record.object].push_back(index);
+        }
+        prologue.push_back(std::move(record));
+
+        if (deadRecords > 4096 && deadRecords > prologue.size() / 2)
+            Compact();
+    }
+
+    void Kill(size_t index)
+    {
+        Record& record = prologue[index];
+        if (!record.live)
+            return;
+        record.live = false;
+        record.blob = std::vector<unsigned char>();
+        deadRecords++;
+    }
+
+    // Drops every prologue record of a deleted object
+    void Forget(int ns, GLuint name)
+    {
+        auto it = objects.find(getObjectKey(ns, name));
+        if (it == objects.end())
+            return;
+        for (size_t index : it->second) {
+            if (prologue[index].live && prologue[index].key) {
+                auto keyed = latest.find(prologue[index].key);
+                if (keyed != latest.end() && keyed->second == index)
+                    latest.erase(keyed);
+            }
+            Kill(index);
+        }
+        objects.erase(it);
+    }
+
+    void Compact()
+    {
+        std::vector<Record> live;
+        live.reserve(prologue.size() - deadRecords);
+        latest.clear();
+        objects.clear();
+        for (Record& record : prologue) {
+            if (!record.live)
+                continue;
+            size_t index = live.size();
+            const TraceOpInfo& info = getTraceOpInfo(record.op);
+            if (info.keyArgs >= 0)
+                latest[record.key] = index;
+            if (info.object != TRACE_NS_NONE)
+                objects[record.object].push_back(index);
+            live.push_back(std::move(record));
+        }
+        prologue.swap(live);
+        deadRecords = 0;
+    }
+
+    // Global state and bindings at the start of the frame, so that every replayed loop starts out the same
+    void RecordFrameStart()
+    {
+        for (const Record& record : prologue)
+            if (record.live && (getTraceOpInfo(record.op).flags & TRACE_STATE))
+                frame.push_back(record);
+
+        Add(TRACE_BIND_FRAMEBUFFER, { GL_READ_FRAMEBUFFER, readFramebuffer });
+        Add(TRACE_BIND_FRAMEBUFFER, { GL_DRAW_FRAMEBUFFER, drawFramebuffer });
+        Add(TRACE_BIND_RENDERBUFFER, { GL_RENDERBUFFER, renderbuffer });
+        Add(TRACE_USE_PROGRAM, { program });
+        Add(TRACE_BIND_VERTEX_ARRAY, { vertexArray });
+        for (const auto& binding : buffers)
+            Add(TRACE_BIND_BUFFER, { binding.first, binding.second });
+        for (const auto& binding : textures) {
+            Add(TRACE_ACTIVE_TEXTURE, { (uint32_t)(binding.first >> 32) });
+            Add(TRACE_BIND_TEXTURE, { (uint32_t)binding.first, binding.second });
+        }
+        Add(TRACE_ACTIVE_TEXTURE, { activeTexture });
+    }
+
+    static void WriteRecord(std::ofstream& out, const Record& record)
+    {
+        uint32_t blobSize = (uint32_t)record.blob.size();
+        out.write((const char*)&record.op, 2);
+        out.write((const char*)&record.argCount, 2);
+        out.write((const char*)&blobSize, 4);
+        out.write((const char*)record.args, record.argCount * 4);
+        if (blobSize)
+            out.write((const char*)&record.blob[0], blobSize);
+        static const char padding[4] = {};
+        out.write(padding, (4 - blobSize % 4) % 4);
+    }
+
+    // Writes the prologue as it is when the frame starts, the frame's own calls keep changing it afterwards
+    bool BeginWrite()
+    {
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "ERROR: Could not create trace " << path << "\n";
+            return false;
+        }
+
+        header.magic = TRACE_MAGIC;
+        header.version = TRACE_VERSION;
+        header.prologueCount = (uint32_t)(prologue.size() - deadRecords);
+        header.frameCount = 0;
+        out.write((const char*)&header, sizeof(header));
+        for (const Record& record : prologue)
+            if (record.live)
+                WriteRecord(out, record);
+        return true;
+    }
+
+    void FinishWrite()
+    {
+        for (const Record& record : frame)
+            WriteRecord(out, record);
+        header.frameCount = (uint32_t)frame.size();
+        out.seekp(0);
+        out.write((const char*)&header, sizeof(header));
+        out.close();
+
+        std::cout << "Captured " << header.prologueCount << " + " << header.frameCount << " calls to " << path << "\n";
+    }
+
+    // ===================== Wrappers =====================
+
+    // The functions the wrappers forward to
+    struct
+    {
+        PFNGLGENBUFFERSPROC GenBuffers;
+        PFNGLGENTEXTURESPROC GenTextures;
+        PFNGLGENVERTEXARRAYSPROC GenVertexArrays;
+        PFNGLGENFRAMEBUFFERSPROC GenFramebuffers;
+        PFNGLGENRENDERBUFFERSPROC GenRenderbuffers;
+        PFNGLCREATESHADERPROC CreateShader;
+        PFNGLCREATEPROGRAMPROC CreateProgram;
+        PFNGLDELETEBUFFERSPROC DeleteBuffers;
+        PFNGLDELETETEXTURESPROC DeleteTextures;
+        PFNGLDELETEVERTEXARRAYSPROC DeleteVertexArrays;
+        PFNGLDELETEFRAMEBUFFERSPROC DeleteFramebuffers;
+        PFNGLDELETERENDERBUFFERSPROC DeleteRenderbuffers;
+        PFNGLDELETESHADERPROC DeleteShader;
+        PFNGLDELETEPROGRAMPROC DeleteProgram;
+        PFNGLSHADERSOURCEPROC ShaderSource;
+        PFNGLSHADERBINARYPROC ShaderBinary;
+        PFNGLSPECIALIZESHADERPROC SpecializeShader;
+        PFNGLCOMPILESHADERPROC CompileShader;
+        PFNGLATTACHSHADERPROC AttachShader;
+        PFNGLDETACHSHADERPROC DetachShader;
+        PFNGLLINKPROGRAMPROC LinkProgram;
+        PFNGLGETUNIFORMLOCATIONPROC GetUniformLocation;
+        PFNGLUSEPROGRAMPROC UseProgram;
+        PFNGLUNIFORM1IPROC Uniform1i;
+        PFNGLUNIFORM1FPROC Uniform1f;
+        PFNGLUNIFORM2FPROC Uniform2f;
+        PFNGLUNIFORM3FPROC Uniform3f;
+        PFNGLUNIFORM4FPROC Uniform4f;
+        PFNGLUNIFORM2FVPROC Uniform2fv;
+        PFNGLUNIFORM3FVPROC Uniform3fv;
+        PFNGLUNIFORM4FVPROC Uniform4fv;
+        PFNGLUNIFORMMATRIX2FVPROC UniformMatrix2fv;
+        PFNGLUNIFORMMATRIX3FVPROC UniformMatrix3fv;
+        PFNGLUNIFORMMATRIX4FVPROC UniformMatrix4fv;
+        PFNGLBINDBUFFERPROC BindBuffer;
+        PFNGLBUFFERDATAPROC BufferData;
+        PFNGLBUFFERSUBDATAPROC BufferSubData;
+        PFNGLACTIVETEXTUREPROC ActiveTexture;
+        PFNGLBINDTEXTUREPROC BindTexture;
+        PFNGLTEXIMAGE2DPROC TexImage2D;
+        PFNGLTEXPARAMETERIPROC TexParameteri;
+        PFNGLGENERATEMIPMAPPROC GenerateMipmap;
+        PFNGLTEXBUFFERPROC TexBuffer;
+        PFNGLBINDVERTEXARRAYPROC BindVertexArray;
+        PFNGLVERTEXATTRIBPOINTERPROC VertexAttribPointer;
+        PFNGLENABLEVERTEXATTRIBARRAYPROC EnableVertexAttribArray;
+        PFNGLDISABLEVERTEXATTRIBARRAYPROC DisableVertexAttribArray;
+        PFNGLBINDFRAMEBUFFERPROC BindFramebuffer;
+        PFNGLBINDRENDERBUFFERPROC BindRenderbuffer;
+        PFNGLFRAMEBUFFERTEXTURE2DPROC FramebufferTexture2D;
+        PFNGLFRAMEBUFFERRENDERBUFFERPROC FramebufferRenderbuffer;
+        PFNGLRENDERBUFFERSTORAGEPROC RenderbufferStorage;
+        PFNGLBLITFRAMEBUFFERPROC BlitFramebuffer;
+        PFNGLENABLEPROC Enable;
+        PFNGLDISABLEPROC Disable;
+        PFNGLVIEWPORTPROC Viewport;
+        PFNGLSCISSORPROC Scissor;
+        PFNGLCLEARCOLORPROC ClearColor;
+        PFNGLDEPTHFUNCPROC DepthFunc;
+        PFNGLBLENDFUNCPROC BlendFunc;
+        PFNGLCULLFACEPROC CullFace;
+        PFNGLPOLYGONMODEPROC PolygonMode;
+        PFNGLCLEARPROC Clear;
+        PFNGLDRAWARRAYSPROC DrawArrays;
+        PFNGLDRAWARRAYSINSTANCEDPROC DrawArraysInstanced;
+        PFNGLDRAWELEMENTSPROC DrawElements;
+        PFNGLDRAWELEMENTSINSTANCEDPROC DrawElementsInstanced;
+        PFNGLGETINTEGERVPROC GetIntegerv;
+    } real = {};
+
+    template <class F>
+    static void Hook(F& slot, F& saved, F wrapper) { saved = slot; slot = wrapper; }
+    template <class F>
+    static void Unhook(F& slot, F& saved) { slot = saved; saved = nullptr; }
+
+    static void APIENTRY GenBuffers(GLsizei n, GLuint* names)
+    {
+        Get().real.GenBuffers(n, names);
+        for (GLsizei i = 0; i < n; i++)
+            Get().Add(TRACE_GEN_BUFFER, { names[i] });
+    }
+    static void APIENTRY GenTextures(GLsizei n, GLuint* names)
+    {
+        Get().real.GenTextures(n, names);
+        for (GLsizei i = 0; i < n; i++)
+            Get().Add(TRACE_GEN_TEXTURE, { names[i] });
+    }
+    static void APIENTRY GenVertexArrays(GLsizei n, GLuint* names)
+    {
+        Get().real.GenVertexArrays(n, names);
+        for (GLsizei i = 0; i < n; i++)
+            Get().Add(TRACE_GEN_VERTEX_ARRAY, { names[i] });
+    }
+    static void APIENTRY GenFramebuffers(GLsizei n, GLuint* names)
+    {
+        Get().real.GenFramebuffers(n, names);
+        for (GLsizei i = 0; i < n; i++)
+            Get().Add(TRACE_GEN_FRAMEBUFFER, { names[i] });
+    }
+    static void APIENTRY GenRenderbuffers(GLsizei n, GLuint* names)
+    {
+        Get().real.GenRenderbuffers(n, names);
+        for (GLsizei i = 0; i < n; i++)
+            Get().Add(TRACE_GEN_RENDERBUFFER, { names[i] });
+    }
+    static GLuint APIENTRY CreateShader(GLenum type)
+    {
+        GLuint name = Get().real.CreateShader(type);
+        Get().Add(TRACE_CREATE_SHADER, { name, type });
+        return name;
+    }
+    static GLuint APIENTRY CreateProgram()
+    {
+        GLuint name = Get().real.CreateProgram();
+        Get().Add(TRACE_CREATE_PROGRAM, { name });
+        return name;
+    }
+
+    // Deleting a bound object resets the binding to 0
+    static void APIENTRY DeleteBuffers(GLsizei n, const GLuint* names)
+    {
+        GLCapture& capture = Get();
+        for (GLsizei i = 0; i < n; i++) {
+            for (auto& binding : capture.buffers)
+                if (binding.second == names[i])
+                    binding.second = 0;
+            capture.Add(TRACE_DELETE_BUFFER, { names[i] });
+        }
+        capture.real.DeleteBuffers(n, names);
+    }
+    static void APIENTRY DeleteTextures(GLsizei n, const GLuint* names)
+    {
+        GLCapture& capture = Get();
+        for (GLsizei i = 0; i < n; i++) {
+            for (auto& binding : capture.textures)
+                if (binding.second == names[i])
+                    binding.second = 0;
+            capture.Add(TRACE_DELETE_TEXTURE, { names[i] });
+        }
+        capture.real.DeleteTextures(n, names);
+    }
+    static void APIENTRY DeleteVertexArrays(GLsizei n, const GLuint* names)
+    {
+        GLCapture& capture = Get();
+        for (GLsizei i = 0; i < n; i++) {
+            if (capture.vertexArray == names[i])
+                capture.vertexArray = 0;
+            capture.Add(TRACE_DELETE_VERTEX_ARRAY, { names[i] });
+        }
+        capture.real.DeleteVertexArrays(n, names);
+    }
+    static void APIENTRY DeleteFramebuffers(GLsizei n, const GLuint* names)
+    {
+        GLCapture& capture = Get();
+        for (GLsizei i = 0; i < n; i++) {
+            if (capture.readFramebuffer == names[i])
+                capture.readFramebuffer = 0;
+            if (capture.drawFramebuffer == names[i])
+                capture.drawFramebuffer = 0;
+            capture.Add(TRACE_DELETE_FRAMEBUFFER, { names[i] });
+        }
+        capture.real.DeleteFramebuffers(n, names);
+    }
+    static void APIENTRY DeleteRenderbuffers(GLsizei n, const GLuint* names)
+    {
+        GLCapture& capture = Get();
+        for (GLsizei i = 0; i < n; i++) {
+            if (capture.renderbuffer == names[i])
+                capture.renderbuffer = 0;
+            capture.Add(TRACE_DELETE_RENDERBUFFER, { names[i] });
+        }
+        capture.real.DeleteRenderbuffers(n, names);
+    }
+    static void APIENTRY DeleteShader(GLuint name)
+    {
+        Get().Add(TRACE_DELETE_SHADER, { name });
+        Get().real.DeleteShader(name);
+    }
+    static void APIENTRY DeleteProgram(GLuint name)
+    {
+        Get().Add(TRACE_DELETE_PROGRAM, { name });
+        Get().real.DeleteProgram(name);
+    }
+
+    static void APIENTRY ShaderSource(GLuint shader, GLsizei count, const GLchar* const* strings, const GLint* lengths)
+    {
+        std::string source;
+        for (GLsizei i = 0; i < count; i++) {
+            if (lengths && lengths[i] >= 0)
+                source.append(strings[i], lengths[i]);
+            else
+                source.append(strings[i]);
+        }
+        Get().Add(TRACE_SHADER_SOURCE, { shader }, source.data(), source.size());
+        Get().real.ShaderSource(shader, count, strings, lengths);
+    }
+    static void APIENTRY ShaderBinary(GLsizei count, const GLuint* shaders, GLenum format, const void* binary, GLsizei length)
+    {
+        for (GLsizei i = 0; i < count; i++)
+            Get().Add(TRACE_SHADER_BINARY, { shaders[i], format }, binary, length);
+        Get().real.ShaderBinary(count, shaders, format, binary, length);
+    }
+    static void APIENTRY SpecializeShader(GLuint shader, const GLchar* entryPoint, GLuint constantCount, const GLuint* indices, const GLuint* values)
+    {
+        std::vector<unsigned char> blob(entryPoint, entryPoint + strlen(entryPoint) + 1);
+        blob.insert(blob.end(), (const unsigned char*)indices, (const unsigned char*)(indices + constantCount));
+        blob.insert(blob.end(), (const unsigned char*)values, (const unsigned char*)(values + constantCount));
+        Get().Add(TRACE_SPECIALIZE_SHADER, { shader, constantCount }, blob.data(), blob.size());
+        Get().real.SpecializeShader(shader, entryPoint, constantCount, indices, values);
+    }
+    static void APIENTRY CompileShader(GLuint shader)
+    {
+        Get().Add(TRACE_COMPILE_SHADER, { shader });
+        Get().real.CompileShader(shader);
+    }
+    static void APIENTRY AttachShader(GLuint program, GLuint shader)
+    {
+        Get().Add(TRACE_ATTACH_SHADER, { program, shader });
+        Get().real.AttachShader(program, shader);
+    }
+    static void APIENTRY DetachShader(GLuint program, GLuint shader)
+    {
+        Get().Add(TRACE_DETACH_SHADER, { program, shader });
+        Get().real.DetachShader(program, shader);
+    }
+    static void APIENTRY LinkProgram(GLuint program)
+    {
+        Get().Add(TRACE_LINK_PROGRAM, { program });
+        Get().real.LinkProgram(program);
+    }
+
+    // Locations differ between drivers, so the replay looks every one up again and remaps them
+    static GLint APIENTRY GetUniformLocation(GLuint program, const GLchar* name)
+    {
+        GLint location = Get().real.GetUniformLocation(program, name);
+        Get().Add(TRACE_GET_UNIFORM_LOCATION, { program, (uint32_t)location }, name, strlen(name));
+        return location;
+    }
+    static void APIENTRY UseProgram(GLuint program)
+    {
+        Get().program = program;
+        Get().Add(TRACE_USE_PROGRAM, { program });
+        Get().real.UseProgram(program);
+    }
+
+    static void APIENTRY Uniform1i(GLint location, GLint v0)
+    {
+        Get().Add(TRACE_UNIFORM_1I, { Get().program, (uint32_t)location, (uint32_t)v0 });
+        Get().real.Uniform1i(location, v0);
+    }
+    static void APIENTRY Uniform1f(GLint location, GLfloat v0)
+    {
+        Get().Add(TRACE_UNIFORM_1F, { Get().program, (uint32_t)location, Bits(v0) });
+        Get().real.Uniform1f(location, v0);
+    }
+    static void APIENTRY Uniform2f(GLint location, GLfloat v0, GLfloat v1)
+    {
+        Get().Add(TRACE_UNIFORM_2F, { Get().program, (uint32_t)location, Bits(v0), Bits(v1) });
+        Get().real.Uniform2f(location, v0, v1);
+    }
+    static void APIENTRY Uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+    {
+        Get().Add(TRACE_UNIFORM_3F, { Get().program, (uint32_t)location, Bits(v0), Bits(v1), Bits(v2) });
+        Get().real.Uniform3f(location, v0, v1, v2);
+    }
+    static void APIENTRY Uniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+    {
+        Get().Add(TRACE_UNIFORM_4F, { Get().program, (uint32_t)location, Bits(v0), Bits(v1), Bits(v2), Bits(v3) });
+        Get().real.Uniform4f(location, v0, v1, v2, v3);
+    }
+    static void APIENTRY Uniform2fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        Get().Add(TRACE_UNIFORM_2FV, { Get().program, (uint32_t)location, (uint32_t)count }, value, count * 2 * sizeof(GLfloat));
+        Get().real.Uniform2fv(location, count, value);
+    }
+    static void APIENTRY Uniform3fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        Get().Add(TRACE_UNIFORM_3FV, { Get().program, (uint32_t)location, (uint32_t)count }, value, count * 3 * sizeof(GLfloat));
+        Get().real.Uniform3fv(location, count, value);
+    }
+    static void APIENTRY Uniform4fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        Get().Add(TRACE_UNIFORM_4FV, { Get().program, (uint32_t)location, (uint32_t)count }, value, count * 4 * sizeof(GLfloat));
+        Get().real.Uniform4fv(location, count, value);
+    }
+    static void APIENTRY UniformMatrix2fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        Get().Add(TRACE_UNIFORM_MATRIX_2FV, { Get().program, (uint32_t)location, (uint32_t)count, transpose }, value, count * 4 * sizeof(GLfloat));
+        Get().real.UniformMatrix2fv(location, count, transpose, value);
+    }
+    static void APIENTRY UniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        Get().Add(TRACE_UNIFORM_MATRIX_3FV, { Get().program, (uint32_t)location, (uint32_t)count, transpose }, value, count * 9 * sizeof(GLfloat));
+        Get().real.UniformMatrix3fv(location, count, transpose, value);
+    }
+    static void APIENTRY UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        Get().Add(TRACE_UNIFORM_MATRIX_4FV, { Get().program, (uint32_t)location, (uint32_t)count, transpose }, value, count * 16 * sizeof(GLfloat));
+        Get().real.UniformMatrix4fv(location, count, transpose, value);
+    }
+
+    static void APIENTRY BindBuffer(GLenum target, GLuint buffer)
+    {
+        GLCapture& capture = Get();
+        // The element buffer binding is part of the vertex array, so it's kept as vertex array state. Inside the
+        // captured frame the same record also replays the bind in place, as it names the bound vertex array.
+        if (target == GL_ELEMENT_ARRAY_BUFFER)
+            capture.Add(TRACE_ELEMENT_BUFFER, { capture.vertexArray, buffer });
+        else
+            capture.Add(TRACE_BIND_BUFFER, { target, buffer });
+        if (target != GL_ELEMENT_ARRAY_BUFFER)
+            capture.buffers[target] = buffer;
+        capture.real.BindBuffer(target, buffer);
+    }
+    static void APIENTRY BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+    {
+        GLCapture& capture = Get();
+        GLuint buffer = target == GL_ELEMENT_ARRAY_BUFFER ? capture.getElementBuffer() : capture.getBoundBuffer(target);
+        capture.Add(TRACE_BUFFER_DATA, { buffer, target, (uint32_t)size, usage }, data, data ? (size_t)size : 0);
+        capture.real.BufferData(target, size, data, usage);
+    }
+    static void APIENTRY BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+    {
+        GLCapture& capture = Get();
+        GLuint buffer = target == GL_ELEMENT_ARRAY_BUFFER ? capture.getElementBuffer() : capture.getBoundBuffer(target);
+        capture.Add(TRACE_BUFFER_SUB_DATA, { buffer, (uint32_t)offset, (uint32_t)size, target }, data, (size_t)size);
+        capture.real.BufferSubData(target, offset, size, data);
+    }
+
+    GLuint getElementBuffer() const
+    {
+        GLint buffer = 0;
+        real.GetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &buffer);
+        return (GLuint)buffer;
+    }
+
+    static void APIENTRY ActiveTexture(GLenum unit)
+    {
+        Get().activeTexture = unit;
+        Get().Add(TRACE_ACTIVE_TEXTURE, { unit });
+        Get().real.ActiveTexture(unit);
+    }
+    static void APIENTRY BindTexture(GLenum target, GLuint texture)
+    {
+        GLCapture& capture = Get();
+        capture.textures[TextureKey(capture.activeTexture, target)] = texture;
+        capture.Add(TRACE_BIND_TEXTURE, { target, texture });
+        capture.real.BindTexture(target, texture);
+    }
+    static void APIENTRY TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels)
+    {
+        GLCapture& capture = Get();
+        GLint alignment = 4;
+        capture.real.GetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+
+        // Rows are padded to the unpack alignment, except for the last one
+        size_t size = 0;
+        if (pixels && width > 0 && height > 0) {
+            size_t row = getPixelSize(format, type) * width;
+            size = (row + alignment - 1) / alignment * alignment * (height - 1) + row;
+        }
+        capture.Add(TRACE_TEX_IMAGE_2D, { capture.getBoundTexture(target), target, (uint32_t)level, (uint32_t)internalFormat,
+            (uint32_t)width, (uint32_t)height, format, type, (uint32_t)alignment }, pixels, size);
+        capture.real.TexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+    }
+    static void APIENTRY TexParameteri(GLenum target, GLenum name, GLint value)
+    {
+        Get().Add(TRACE_TEX_PARAMETER_I, { Get().getBoundTexture(target), name, target, (uint32_t)value });
+        Get().real.TexParameteri(target, name, value);
+    }
+    static void APIENTRY GenerateMipmap(GLenum target)
+    {
+        Get().Add(TRACE_GENERATE_MIPMAP, { Get().getBoundTexture(target), target });
+        Get().real.GenerateMipmap(target);
+    }
+    static void APIENTRY TexBuffer(GLenum target, GLenum internalFormat, GLuint buffer)
+    {
+        Get().Add(TRACE_TEX_BUFFER, { Get().getBoundTexture(target), target, internalFormat, buffer });
+        Get().real.TexBuffer(target, internalFormat, buffer);
+    }
+
+    static void APIENTRY BindVertexArray(GLuint vertexArray)
+    {
+        Get().vertexArray = vertexArray;
+        Get().Add(TRACE_BIND_VERTEX_ARRAY, { vertexArray });
+        Get().real.BindVertexArray(vertexArray);
+    }
+    static void APIENTRY VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* offset)
+    {
+        GLCapture& capture = Get();
+        capture.Add(TRACE_VERTEX_ATTRIB_POINTER, { capture.vertexArray, index, capture.getBoundBuffer(GL_ARRAY_BUFFER),
+            (uint32_t)size, type, normalized, (uint32_t)stride, (uint32_t)(uintptr_t)offset });
+        capture.real.VertexAttribPointer(index, size, type, normalized, stride, offset);
+    }
+    static void APIENTRY EnableVertexAttribArray(GLuint index)
+    {
+        Get().Add(TRACE_ENABLE_VERTEX_ATTRIB, { Get().vertexArray, index });
+        Get().real.EnableVertexAttribArray(index);
+    }
+    static void APIENTRY DisableVertexAttribArray(GLuint index)
+    {
+        Get().Add(TRACE_DISABLE_VERTEX_ATTRIB, { Get().vertexArray, index });
+        Get().real.DisableVertexAttribArray(index);
+    }
+
+    static void APIENTRY BindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        GLCapture& capture = Get();
+        if (target != GL_DRAW_FRAMEBUFFER)
+            capture.readFramebuffer = framebuffer;
+        if (target != GL_READ_FRAMEBUFFER)
+            capture.drawFramebuffer = framebuffer;
+        capture.Add(TRACE_BIND_FRAMEBUFFER, { target, framebuffer });
+        capture.real.BindFramebuffer(target, framebuffer);
+    }
+    static void APIENTRY BindRenderbuffer(GLenum target, GLuint renderbuffer)
+    {
+        Get().renderbuffer = renderbuffer;
+        Get().Add(TRACE_BIND_RENDERBUFFER, { target, renderbuffer });
+        Get().real.BindRenderbuffer(target, renderbuffer);
+    }
+    static void APIENTRY FramebufferTexture2D(GLenum target, GLenum attachment, GLenum textureTarget, GLuint texture, GLint level)
+    {
+        Get().Add(TRACE_FRAMEBUFFER_TEXTURE_2D, { Get().getBoundFramebuffer(target), attachment, target, textureTarget, texture, (uint32_t)level });
+        Get().real.FramebufferTexture2D(target, attachment, textureTarget, texture, level);
+    }
+    static void APIENTRY FramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbufferTarget, GLuint renderbuffer)
+    {
+        Get().Add(TRACE_FRAMEBUFFER_RENDERBUFFER, { Get().getBoundFramebuffer(target), attachment, target, renderbufferTarget, renderbuffer });
+        Get().real.FramebufferRenderbuffer(target, attachment, renderbufferTarget, renderbuffer);
+    }
+    static void APIENTRY RenderbufferStorage(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height)
+    {
+        Get().Add(TRACE_RENDERBUFFER_STORAGE, { Get().renderbuffer, target, internalFormat, (uint32_t)width, (uint32_t)height });
+        Get().real.RenderbufferStorage(target, internalFormat, width, height);
+    }
+    static void APIENTRY BlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter)
+    {
+        Get().Add(TRACE_BLIT_FRAMEBUFFER, { (uint32_t)srcX0, (uint32_t)srcY0, (uint32_t)srcX1, (uint32_t)srcY1,
+            (uint32_t)dstX0, (uint32_t)dstY0, (uint32_t)dstX1, (uint32_t)dstY1, mask, filter });
+        Get().real.BlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+    }
+
+    static void APIENTRY Enable(GLenum capability)
+    {
+        Get().Add(TRACE_ENABLE, { capability });
+        Get().real.Enable(capability);
+    }
+    static void APIENTRY Disable(GLenum capability)
+    {
+        Get().Add(TRACE_DISABLE, { capability });
+        Get().real.Disable(capability);
+    }
+    static void APIENTRY Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        Get().Add(TRACE_VIEWPORT, { (uint32_t)x, (uint32_t)y, (uint32_t)width, (uint32_t)height });
+        Get().real.Viewport(x, y, width, height);
+    }
+    static void APIENTRY Scissor(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        Get().Add(TRACE_SCISSOR, { (uint32_t)x, (uint32_t)y, (uint32_t)width, (uint32_t)height });
+        Get().real.Scissor(x, y, width, height);
+    }
+    static void APIENTRY ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+    {
+        Get().Add(TRACE_CLEAR_COLOR, { Bits(r), Bits(g), Bits(b), Bits(a) });
+        Get().real.ClearColor(r, g, b, a);
+    }
+    static void APIENTRY DepthFunc(GLenum func)
+    {
+        Get().Add(TRACE_DEPTH_FUNC, { func });
+        Get().real.DepthFunc(func);
+    }
+    static void APIENTRY BlendFunc(GLenum source, GLenum destination)
+    {
+        Get().Add(TRACE_BLEND_FUNC, { source, destination });
+        Get().real.BlendFunc(source, destination);
+    }
+    static void APIENTRY CullFace(GLenum face)
+    {
+        Get().Add(TRACE_CULL_FACE, { face });
+        Get().real.CullFace(face);
+    }
+    static void APIENTRY PolygonMode(GLenum face, GLenum mode)
+    {
+        Get().Add(TRACE_POLYGON_MODE, { face, mode });
+        Get().real.PolygonMode(face, mode);
+    }
+
+    static void APIENTRY Clear(GLbitfield mask)
+    {
+        Get().Add(TRACE_CLEAR, { mask });
+        Get().real.Clear(mask);
+    }
+    static void APIENTRY DrawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        Get().Add(TRACE_DRAW_ARRAYS, { mode, (uint32_t)first, (uint32_t)count });
+        Get().real.DrawArrays(mode, first, count);
+    }
+    static void APIENTRY DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances)
+    {
+        Get().Add(TRACE_DRAW_ARRAYS_INSTANCED, { mode, (uint32_t)first, (uint32_t)count, (uint32_t)instances });
+        Get().real.DrawArraysInstanced(mode, first, count, instances);
+    }
+    static void APIENTRY DrawElements(GLenum mode, GLsizei count, GLenum type, const void* offset)
+    {
+        Get().Add(TRACE_DRAW_ELEMENTS, { mode, (uint32_t)count, type, (uint32_t)(uintptr_t)offset });
+        Get().real.DrawElements(mode, count, type, offset);
+    }
+    static void APIENTRY DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* offset, GLsizei instances)
+    {
+        Get().Add(TRACE_DRAW_ELEMENTS_INSTANCED, { mode, (uint32_t)count, type, (uint32_t)(uintptr_t)offset, (uint32_t)instances });
+        Get().real.DrawElementsInstanced(mode, count, type, offset, instances);
+    }
+};
+
+inline void GLCapture::Install()
+{
+    if (installed)
+        return;
+    installed = true;
+
+    real.GetIntegerv = glad_glGetIntegerv;
+    Hook(glad_glGenBuffers, real.GenBuffers, &GenBuffers);
+    Hook(glad_glGenTextures, real.GenTextures, &GenTextures);
+    Hook(glad_glGenVertexArrays, real.GenVertexArrays, &GenVertexArrays);
+    Hook(glad_glGenFramebuffers, real.GenFramebuffers, &GenFramebuffers);
+    Hook(glad_glGenRenderbuffers, real.GenRenderbuffers, &GenRenderbuffers);
+    Hook(glad_glCreateShader, real.CreateShader, &CreateShader);
+    Hook(glad_glCreateProgram, real.CreateProgram, &CreateProgram);
+    Hook(glad_glDeleteBuffers, real.DeleteBuffers, &DeleteBuffers);
+    Hook(glad_glDeleteTextures, real.DeleteTextures, &DeleteTextures);
+    Hook(glad_glDeleteVertexArrays, real.DeleteVertexArrays, &DeleteVertexArrays);
+    Hook(glad_glDeleteFramebuffers, real.DeleteFramebuffers, &DeleteFramebuffers);
+    Hook(glad_glDeleteRenderbuffers, real.DeleteRenderbuffers, &DeleteRenderbuffers);
+    Hook(glad_glDeleteShader, real.DeleteShader, &DeleteShader);
+    Hook(glad_glDeleteProgram, real.DeleteProgram, &DeleteProgram);
+    Hook(glad_glShaderSource, real.ShaderSource, &ShaderSource);
+    Hook(glad_glShaderBinary, real.ShaderBinary, &ShaderBinary);
+    Hook(glad_glSpecializeShader, real.SpecializeShader, &SpecializeShader);
+    Hook(glad_glCompileShader, real.CompileShader, &CompileShader);
+    Hook(glad_glAttachShader, real.AttachShader, &AttachShader);
+    Hook(glad_glDetachShader, real.DetachShader, &DetachShader);
+    Hook(glad_glLinkProgram, real.LinkProgram, &LinkProgram);
+    Hook(glad_glGetUniformLocation, real.GetUniformLocation, &GetUniformLocation);
+    Hook(glad_glUseProgram, real.UseProgram, &UseProgram);
+    Hook(glad_glUniform1i, real.Uniform1i, &Uniform1i);
+    Hook(glad_glUniform1f, real.Uniform1f, &Uniform1f);
+    Hook(glad_glUniform2f, real.Uniform2f, &Uniform2f);
+    Hook(glad_glUniform3f, real.Uniform3f, &Uniform3f);
+    Hook(glad_glUniform4f, real.Uniform4f, &Uniform4f);
+    Hook(glad_glUniform2fv, real.Uniform2fv, &Uniform2fv);
+    Hook(glad_glUniform3fv, real.Uniform3fv, &Uniform3fv);
+    Hook(glad_glUniform4fv, real.Uniform4fv, &Uniform4fv);
+    Hook(glad_glUniformMatrix2fv, real.UniformMatrix2fv, &UniformMatrix2fv);
+    Hook(glad_glUniformMatrix3fv, real.UniformMatrix3fv, &UniformMatrix3fv);
+    Hook(glad_glUniformMatrix4fv, real.UniformMatrix4fv, &UniformMatrix4fv);
+    Hook(glad_glBindBuffer, real.BindBuffer, &BindBuffer);
+    Hook(glad_glBufferData, real.BufferData, &BufferData);
+    Hook(glad_glBufferSubData, real.BufferSubData, &BufferSubData);
+    Hook(glad_glActiveTexture, real.ActiveTexture, &ActiveTexture);
+    Hook(glad_glBindTexture, real.BindTexture, &BindTexture);
+    Hook(glad_glTexImage2D, real.TexImage2D, &TexImage2D);
+    Hook(glad_glTexParameteri, real.TexParameteri, &TexParameteri);
+    Hook(glad_glGenerateMipmap, real.GenerateMipmap, &GenerateMipmap);
+    Hook(glad_glTexBuffer, real.TexBuffer, &TexBuffer);
+    Hook(glad_glBindVertexArray, real.BindVertexArray, &BindVertexArray);
+    Hook(glad_glVertexAttribPointer, real.VertexAttribPointer, &VertexAttribPointer);
+    Hook(glad_glEnableVertexAttribArray, real.EnableVertexAttribArray, &EnableVertexAttribArray);
+    Hook(glad_glDisableVertexAttribArray, real.DisableVertexAttribArray, &DisableVertexAttribArray);
+    Hook(glad_glBindFramebuffer, real.BindFramebuffer, &BindFramebuffer);
+    Hook(glad_glBindRenderbuffer, real.BindRenderbuffer, &BindRenderbuffer);
+    Hook(glad_glFramebufferTexture2D, real.FramebufferTexture2D, &FramebufferTexture2D);
+    Hook(glad_glFramebufferRenderbuffer, real.FramebufferRenderbuffer, &FramebufferRenderbuffer);
+    Hook(glad_glRenderbufferStorage, real.RenderbufferStorage, &RenderbufferStorage);
+    Hook(glad_glBlitFramebuffer, real.BlitFramebuffer, &BlitFramebuffer);
+    Hook(glad_glEnable, real.Enable, &Enable);
+    Hook(glad_glDisable, real.Disable, &Disable);
+    Hook(glad_glViewport, real.Viewport, &Viewport);
+    Hook(glad_glScissor, real.Scissor, &Scissor);
+    Hook(glad_glClearColor, real.ClearColor, &ClearColor);
+    Hook(glad_glDepthFunc, real.DepthFunc, &DepthFunc);
+    Hook(glad_glBlendFunc, real.BlendFunc, &BlendFunc);
+    Hook(glad_glCullFace, real.CullFace, &CullFace);
+    Hook(glad_glPolygonMode, real.PolygonMode, &PolygonMode);
+    Hook(glad_glClear, real.Clear, &Clear);
+    Hook(glad_glDrawArrays, real.DrawArrays, &DrawArrays);
+    Hook(glad_glDrawArraysInstanced, real.DrawArraysInstanced, &DrawArraysInstanced);
+    Hook(glad_glDrawElements, real.DrawElements, &DrawElements);
+    Hook(glad_glDrawElementsInstanced, real.DrawElementsInstanced, &DrawElementsInstanced);
+}
+
+inline void GLCapture::Uninstall()
+{
+    if (!installed)
+        return;
+    installed = false;
+    state = CAPTURE_IDLE;
+
+    Unhook(glad_glGenBuffers, real.GenBuffers);
+    Unhook(glad_glGenTextures, real.GenTextures);
+    Unhook(glad_glGenVertexArrays, real.GenVertexArrays);
+    Unhook(glad_glGenFramebuffers, real.GenFramebuffers);
+    Unhook(glad_glGenRenderbuffers, real.GenRenderbuffers);
+    Unhook(glad_glCreateShader, real.CreateShader);
+    Unhook(glad_glCreateProgram, real.CreateProgram);
+    Unhook(glad_glDeleteBuffers, real.DeleteBuffers);
+    Unhook(glad_glDeleteTextures, real.DeleteTextures);
+    Unhook(glad_glDeleteVertexArrays, real.DeleteVertexArrays);
+    Unhook(glad_glDeleteFramebuffers, real.DeleteFramebuffers);
+    Unhook(glad_glDeleteRenderbuffers, real.DeleteRenderbuffers);
+    Unhook(glad_glDeleteShader, real.DeleteShader);
+    Unhook(glad_glDeleteProgram, real.DeleteProgram);
+    Unhook(glad_glShaderSource, real.ShaderSource);
+    Unhook(glad_glShaderBinary, real.ShaderBinary);
+    Unhook(glad_glSpecializeShader, real.SpecializeShader);
+    Unhook(glad_glCompileShader, real.CompileShader);
+    Unhook(glad_glAttachShader, real.AttachShader);
+    Unhook(glad_glDetachShader, real.DetachShader);
+    Unhook(glad_glLinkProgram, real.LinkProgram);
+    Unhook(glad_glGetUniformLocation, real.GetUniformLocation);
+    Unhook(glad_glUseProgram, real.UseProgram);
+    Unhook(glad_glUniform1i, real.Uniform1i);
+    Unhook(glad_glUniform1f, real.Uniform1f);
+    Unhook(glad_glUniform2f, real.Uniform2f);
+    Unhook(glad_glUniform3f, real.Uniform3f);
+    Unhook(glad_glUniform4f, real.Uniform4f);
+    Unhook(glad_glUniform2fv, real.Uniform2fv);
+    Unhook(glad_glUniform3fv, real.Uniform3fv);
+    Unhook(glad_glUniform4fv, real.Uniform4fv);
+    Unhook(glad_glUniformMatrix2fv, real.UniformMatrix2fv);
+    Unhook(glad_glUniformMatrix3fv, real.UniformMatrix3fv);
+    Unhook(glad_glUniformMatrix4fv, real.UniformMatrix4fv);
+    Unhook(glad_glBindBuffer, real.BindBuffer);
+    Unhook(glad_glBufferData, real.BufferData);
+    Unhook(glad_glBufferSubData, real.BufferSubData);
+    Unhook(glad_glActiveTexture, real.ActiveTexture);
+    Unhook(glad_glBindTexture, real.BindTexture);
+    Unhook(glad_glTexImage2D, real.TexImage2D);
+    Unhook(glad_glTexParameteri, real.TexParameteri);
+    Unhook(glad_glGenerateMipmap, real.GenerateMipmap);
+    Unhook(glad_glTexBuffer, real.TexBuffer);
+    Unhook(glad_glBindVertexArray, real.BindVertexArray);
+    Unhook(glad_glVertexAttribPointer, real.VertexAttribPointer);
+    Unhook(glad_glEnableVertexAttribArray, real.EnableVertexAttribArray);
+    Unhook(glad_glDisableVertexAttribArray, real.DisableVertexAttribArray);
+    Unhook(glad_glBindFramebuffer, real.BindFramebuffer);
+    Unhook(glad_glBindRenderbuffer, real.BindRenderbuffer);
+    Unhook(glad_glFramebufferTexture2D, real.FramebufferTexture2D);
+    Unhook(glad_glFramebufferRenderbuffer, real.FramebufferRenderbuffer);
+    Unhook(glad_glRenderbufferStorage, real.RenderbufferStorage);
+    Unhook(glad_glBlitFramebuffer, real.BlitFramebuffer);
+    Unhook(glad_glEnable, real.Enable);
+    Unhook(glad_glDisable, real.Disable);
+    Unhook(glad_glViewport, real.Viewport);
+    Unhook(glad_glScissor, real.Scissor);
+    Unhook(glad_glClearColor, real.ClearColor);
+    Unhook(glad_glDepthFunc, real.DepthFunc);
+    Unhook(glad_glBlendFunc, real.BlendFunc);
+    Unhook(glad_glCullFace, real.CullFace);
+    Unhook(glad_glPolygonMode, real.PolygonMode);
+    Unhook(glad_glClear, real.Clear);
+    Unhook(glad_glDrawArrays, real.DrawArrays);
+    Unhook(glad_glDrawArraysInstanced, real.DrawArraysInstanced);
+    Unhook(glad_glDrawElements, real.DrawElements);
+    Unhook(glad_glDrawElementsInstanced, real.DrawElementsInstanced);
+}
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef _H_JOBS_
+#define _H_JOBS_
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <algorithm>
+
+// A small pool of persistent worker threads. Work is handed out with ParallelFor, which splits an index range
+// into chunks that the workers (and the calling thread) pull from until the range is exhausted.
+class JobSystem
+{
+public:
+    // Range callback: processes the indices [begin, end)
+    typedef std::function<void(size_t begin, size_t end)> RangeFunc;
+
+    JobSystem(unsigned int _threadCount = 0) : running(true), generation(0), active(0), chunkSize(1), count(0), next(0), pending(0)
+    {
+        // Leave one hardware thread for the main/render thread, which also helps out in ParallelFor
+        if (_threadCount == 0)
+            _threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+        for (unsigned int i = 0; i < _threadCount; i++)
+            workers.emplace_back(&JobSystem::WorkerLoop, this);
+    }
+    ~JobSystem(void)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Runs func over [0, _count) in chunks of _chunkSize and blocks until every chunk has finished
+    void ParallelFor(size_t _count, size_t _chunkSize, RangeFunc _func)
+    {
+        if (_count == 0)
+            return;
+        if (_chunkSize == 0)
+            _chunkSize = 1;
+
+        // Not worth waking anyone up for a single chunk
+        if (workers.empty() || _count <= _chunkSize) {
+            _func(0, _count);
+            return;
+        }
+
+        // Only one ParallelFor may be in flight at a time
+        std::lock_guard<std::mutex> submitLock(submitMutex);
+        {
+            // Workers that woke up late for the previous range may still be on their way out
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this] { return active == 0; });
+            func = _func;
+            count = _count;
+            chunkSize = _chunkSize;
+            next = 0;
+            pending = (_count + _chunkSize - 1) / _chunkSize;
+            generation++;
+        }
+        wake.notify_all();
+
+        RunChunks();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0 && active == 0; });
+        func = nullptr;
+    }
+
+    unsigned int getThreadCount() const { return (unsigned int)workers.size() + 1; }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::mutex submitMutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool running;
+    unsigned long long generation;
+    unsigned int active;
+
+    RangeFunc func;
+    size_t chunkSize;
+    size_t count;
+    std::atomic<size_t> next;
+    size_t pending;
+
+    void RunChunks()
+    {
+        size_t finished = 0;
+        for (;;) {
+            size_t begin = next.fetch_add(chunkSize);
+            if (begin >= count)
+                break;
+            func(begin, std::min(begin + chunkSize, count));
+            finished++;
+        }
+
+        if (finished) {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending -= finished;
+        }
+        done.notify_all();
+    }
+
+    void WorkerLoop()
+    {
+        unsigned long long seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seen] { return !running || generation != seen; });
+                if (!running)
+                    return;
+                seen = generation;
+                active++;
+            }
+            RunChunks();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                active--;
+            }
+            done.notify_all();
+        }
+    }
+};
+
+#endif
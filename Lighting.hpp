@@ -0,0 +1,398 @@
+#ifndef _H_LIGHTING_
+#define _H_LIGHTING_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include "Jobs.hpp"
+#include "Resource.hpp"
+#include "Shader.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LIGHTING_SSE
+#endif
+
+// A point light, or a spot light when the cone angles are set. Positions and directions are in world space.
+struct Light
+{
+    glm::vec3 position;
+    float radius;           // Distance at which the light has faded out completely
+    glm::vec3 color;
+    float intensity;
+    glm::vec3 direction;    // Only used by spot lights
+    float cosOuter;         // Cosine of the outer cone angle, -1 for point lights
+    float cosInner;         // Cosine of the inner cone angle, where the falloff starts
+
+    static Light Point(glm::vec3 _position, float _radius, glm::vec3 _color, float _intensity = 1.0f)
+    {
+        Light light;
+        light.position = _position;
+        light.radius = _radius;
+        light.color = _color;
+        light.intensity = _intensity;
+        light.direction = glm::vec3(0.0f, 0.0f, -1.0f);
+        light.cosOuter = -1.0f;
+        light.cosInner = -1.0f;
+        return light;
+    }
+
+    // Angles are in degrees, measured from the cone axis
+    static Light Spot(glm::vec3 _position, glm::vec3 _direction, float _radius, float innerAngle, float outerAngle, glm::vec3 _color, float _intensity = 1.0f)
+    {
+        Light light = Point(_position, _radius, _color, _intensity);
+        light.direction = glm::normalize(_direction);
+        light.cosOuter = cos(glm::radians(outerAngle));
+        light.cosInner = cos(glm::radians(innerAngle));
+        return light;
+    }
+
+    bool isSpot() const { return cosOuter > -1.0f; }
+};
+
+// Per-frame statistics
+struct LightingStats
+{
+    unsigned int lights = 0;
+    unsigned int indices = 0;          // Total light references over all clusters
+    unsigned int maxPerCluster = 0;
+    float binningTime = 0.0f;          // Milliseconds spent assigning lights to clusters
+    float uploadTime = 0.0f;           // Milliseconds spent uploading the results
+};
+
+// Clustered forward lighting. The view frustum is split into a grid of screen tiles times exponential depth
+// slices. Every frame the lights are binned into the clusters they touch on the CPU: each depth slice is a job
+// that shortlists the lights overlapping its depth range, then each row of tiles, then tests what's left against
+// each cluster's bounding box four lights at a time. The light data, per-cluster (offset, count) ranges and the
+// flattened index list are uploaded to texture buffers so the fragment shader only loops over the lights of the
+// cluster it falls into.
+class ClusteredLighting
+{
+public:
+    static const int GRID_X = 16;
+    static const int GRID_Y = 9;
+    static const int GRID_Z = 24;
+    static const int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+    // Texture units used by Bind
+    static const int LIGHT_UNIT = 1;
+    static const int CLUSTER_UNIT = 2;
+    static const int INDEX_UNIT = 3;
+
+    ClusteredLighting() : fov(0.0f), aspect(0.0f), nearPlane(0.0f), farPlane(0.0f), ambient(0.1f)
+    {
+        clusterBounds.resize(CLUSTER_COUNT * 2);
+        clusterData.resize(CLUSTER_COUNT * 2);
+        slices.resize(GRID_Z);
+
+        // Each texture buffer wraps a buffer object that gets refilled every frame
+        GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+        for (int i = 0; i < 3; i++) {
+            buffers[i] = BufferHandle::Create();
+            textures[i] = TextureHandle::Create();
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i].get());
+            glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i].get());
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i].get());
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // Bins the lights for this frame's camera and uploads the results. fov is vertical and in degrees.
+    void Update(const std::vector<Light>& lights, const glm::mat4& view, float _fov, float _aspect, float _near, float _far, JobSystem& jobs)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        if (_fov != fov || _aspect != aspect || _near != nearPlane || _far != farPlane) {
+            fov = _fov;
+            aspect = _aspect;
+            nearPlane = _near;
+            farPlane = _far;
+            BuildClusterBounds();
+        }
+
+        TransformLights(lights, view, jobs);
+
+        // Every slice only writes its own clusters and index list, so no synchronization is needed
+        jobs.ParallelFor(GRID_Z, 1, [this](size_t begin, size_t end) {
+            for (size_t z = begin; z < end; z++)
+                BinSlice((int)z);
+        });
+
+        // Stitch the per-slice index lists together
+        indices.clear();
+        stats = LightingStats();
+        stats.lights = (unsigned int)lights.size();
+        for (int z = 0; z < GRID_Z; z++) {
+            unsigned int base = (unsigned int)indices.size();
+            for (int i = 0; i < GRID_X * GRID_Y; i++) {
+                size_t cluster = (size_t)z * GRID_X * GRID_Y + i;
+                clusterData[cluster * 2] += base;
+                stats.maxPerCluster = std::max(stats.maxPerCluster, clusterData[cluster * 2 + 1]);
+            }
+            indices.insert(indices.end(), slices[z].indices.begin(), slices[z].indices.end());
+        }
+        stats.indices = (unsigned int)indices.size();
+
+        auto binned = std::chrono::high_resolution_clock::now();
+        stats.binningTime = std::chrono::duration<float, std::milli>(binned - start).count();
+
+        Upload(lightData.size() * sizeof(glm::vec4), lightData.empty() ? NULL : &lightData[0], 0);
+        Upload(clusterData.size() * sizeof(unsigned int), &clusterData[0], 1);
+        Upload(indices.size() * sizeof(unsigned int), indices.empty() ? NULL : &indices[0], 2);
+        stats.uploadTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - binned).count();
+    }
+
+    // Binds the light buffers and sets the uniforms lighting.glsl expects. The shader has to be bound already.
+    void Bind(const ShaderUniforms& shader, float viewportWidth, float viewportHeight) const
+    {
+        int units[3] = { LIGHT_UNIT, CLUSTER_UNIT, INDEX_UNIT };
+        for (int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE0 + units[i]);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i].Use());
+        }
+        glActiveTexture(GL_TEXTURE0);
+
+        float logRatio = log(farPlane / nearPlane);
+        shader.setInt("lightData", LIGHT_UNIT);
+        shader.setInt("clusterData", CLUSTER_UNIT);
+        shader.setInt("lightIndices", INDEX_UNIT);
+        shader.setVec3("clusterGrid", (float)GRID_X, (float)GRID_Y, (float)GRID_Z);
+        shader.setVec2("clusterDepthParams", GRID_Z / logRatio, -GRID_Z * log(nearPlane) / logRatio);
+        shader.setVec2("viewportSize", viewportWidth, viewportHeight);
+        shader.setVec3("ambientLight", ambient);
+    }
+
+    const LightingStats& getStats() const { return stats; }
+
+    glm::vec3 getAmbient() const { return ambient; }
+    void setAmbient(glm::vec3 _ambient) { ambient = _ambient; }
+
+private:
+    // Shortlisted lights, split up for the SIMD tests and padded to a multiple of four
+    struct LightList
+    {
+        std::vector<unsigned int> lights;
+        std::vector<float> x, y, z, radiusSq;
+
+        void Clear()
+        {
+            lights.clear();
+            x.clear();
+            y.clear();
+            z.clear();
+            radiusSq.clear();
+        }
+        void Add(unsigned int light, glm::vec3 position, float _radiusSq)
+        {
+            lights.push_back(light);
+            x.push_back(position.x);
+            y.push_back(position.y);
+            z.push_back(position.z);
+            radiusSq.push_back(_radiusSq);
+        }
+        // Pads with lights that can't touch anything
+        void Pad()
+        {
+            while (x.size() % 4) {
+                x.push_back(0.0f);
+                y.push_back(0.0f);
+                z.push_back(0.0f);
+                radiusSq.push_back(-1.0f);
+            }
+        }
+    };
+
+    // Binning state for one depth slice
+    struct Slice
+    {
+        LightList sliceLights;  // Lights overlapping the slice's depth range
+        LightList rowLights;    // Lights overlapping the current row of tiles within the slice
+        std::vector<unsigned int> indices;
+    };
+
+    float fov, aspect, nearPlane, farPlane;
+    glm::vec3 ambient;
+    std::vector<glm::vec3> clusterBounds;   // View space min and max per cluster
+    std::vector<unsigned int> clusterData;  // Offset and count per cluster
+    std::vector<unsigned int> indices;
+    std::vector<glm::vec4> lightData;       // Three texels per light, see lighting.glsl
+    std::vector<Light> viewLights;
+    std::vector<Slice> slices;
+    BufferHandle buffers[3];
+    TextureHandle textures[3];
+    LightingStats stats;
+
+    float getSliceDepth(int z) const
+    {
+        return nearPlane * pow(farPlane / nearPlane, (float)z / GRID_Z);
+    }
+
+    void BuildClusterBounds()
+    {
+        float tanY = tan(glm::radians(fov) * 0.5f);
+        float tanX = tanY * aspect;
+
+        for (int z = 0; z < GRID_Z; z++) {
+            float nearDepth = getSliceDepth(z);
+            float farDepth = getSliceDepth(z + 1);
+            for (int y = 0; y < GRID_Y; y++) {
+                for (int x = 0; x < GRID_X; x++) {
+                    float ndcX0 = (float)x / GRID_X * 2.0f - 1.0f, ndcX1 = (float)(x + 1) / GRID_X * 2.0f - 1.0f;
+                    float ndcY0 = (float)y / GRID_Y * 2.0f - 1.0f, ndcY1 = (float)(y + 1) / GRID_Y * 2.0f - 1.0f;
+
+                    // Tiles left of the center widen towards the far end of the slice and tiles right of it
+                    // narrow, so take both ends
+                    float minX = std::min(ndcX0 * tanX * nearDepth, ndcX0 * tanX * farDepth);
+                    float maxX = std::max(ndcX1 * tanX * nearDepth, ndcX1 * tanX * farDepth);
+                    float minY = std::min(ndcY0 * tanY * nearDepth, ndcY0 * tanY * farDepth);
+                    float maxY = std::max(ndcY1 * tanY * nearDepth, ndcY1 * tanY * farDepth);
+
+                    size_t cluster = ((size_t)z * GRID_Y + y) * GRID_X + x;
+                    clusterBounds[cluster * 2] = glm::vec3(minX, minY, -farDepth);
+                    clusterBounds[cluster * 2 + 1] = glm::vec3(maxX, maxY, -nearDepth);
+                }
+            }
+        }
+    }
+
+    void TransformLights(const std::vector<Light>& lights, const glm::mat4& view, JobSystem& jobs)
+    {
+        viewLights.resize(lights.size());
+        lightData.resize(lights.size() * 3);
+        jobs.ParallelFor(lights.size(), 1024, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                Light light = lights[i];
+                light.position = glm::vec3(view * glm::vec4(light.position, 1.0f));
+                light.direction = glm::vec3(view * glm::vec4(light.direction, 0.0f));
+                viewLights[i] = light;
+
+                lightData[i * 3] = glm::vec4(light.position, light.radius);
+                lightData[i * 3 + 1] = glm::vec4(light.color * light.intensity, light.cosOuter);
+                lightData[i * 3 + 2] = glm::vec4(light.direction, light.cosInner);
+            }
+        });
+    }
+
+    // Cone against a cluster's bounding sphere. Only rejects, so lights passing the sphere test are kept when unsure.
+    static bool ConeOverlaps(const Light& light, glm::vec3 center, float radius)
+    {
+        glm::vec3 v = center - light.position;
+        float lengthSq = glm::dot(v, v);
+        float along = glm::dot(v, light.direction);
+        float sinOuter = sqrt(std::max(0.0f, 1.0f - light.cosOuter * light.cosOuter));
+        float closest = light.cosOuter * sqrt(std::max(0.0f, lengthSq - along * along)) - along * sinOuter;
+        return !(closest > radius || along > radius + light.radius || along < -radius);
+    }
+
+    // Narrows the lights down from the whole slice to each row of tiles and then to each cluster
+    void BinSlice(int z)
+    {
+        Slice& slice = slices[z];
+        float sliceNear = -getSliceDepth(z);
+        float sliceFar = -getSliceDepth(z + 1);
+
+        slice.sliceLights.Clear();
+        for (size_t i = 0; i < viewLights.size(); i++) {
+            const Light& light = viewLights[i];
+            if (light.position.z - light.radius <= sliceNear && light.position.z + light.radius >= sliceFar)
+                slice.sliceLights.Add((unsigned int)i, light.position, light.radius * light.radius);
+        }
+        slice.sliceLights.Pad();
+
+        slice.indices.clear();
+        for (int y = 0; y < GRID_Y; y++) {
+            size_t rowStart = ((size_t)z * GRID_Y + y) * GRID_X;
+            glm::vec3 rowMin = clusterBounds[rowStart * 2];
+            glm::vec3 rowMax = clusterBounds[rowStart * 2 + 1];
+            for (int x = 1; x < GRID_X; x++) {
+                rowMin = glm::min(rowMin, clusterBounds[(rowStart + x) * 2]);
+                rowMax = glm::max(rowMax, clusterBounds[(rowStart + x) * 2 + 1]);
+            }
+
+            const LightList& candidates = slice.sliceLights;
+            slice.rowLights.Clear();
+            for (size_t l = 0; l < candidates.x.size(); l += 4) {
+                int hits = SpheresOverlapBox(&candidates.x[l], &candidates.y[l], &candidates.z[l], &candidates.radiusSq[l], rowMin, rowMax);
+                for (int lane = 0; lane < 4; lane++)
+                    if (hits & (1 << lane))
+                        slice.rowLights.Add(candidates.lights[l + lane], glm::vec3(candidates.x[l + lane], candidates.y[l + lane], candidates.z[l + lane]), candidates.radiusSq[l + lane]);
+            }
+            slice.rowLights.Pad();
+
+            const LightList& rowLights = slice.rowLights;
+            for (int x = 0; x < GRID_X; x++) {
+                size_t cluster = rowStart + x;
+                glm::vec3 boundsMin = clusterBounds[cluster * 2];
+                glm::vec3 boundsMax = clusterBounds[cluster * 2 + 1];
+                glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+                float boundingRadius = glm::length(boundsMax - center);
+
+                unsigned int offset = (unsigned int)slice.indices.size();
+                for (size_t l = 0; l < rowLights.x.size(); l += 4) {
+                    int hits = SpheresOverlapBox(&rowLights.x[l], &rowLights.y[l], &rowLights.z[l], &rowLights.radiusSq[l], boundsMin, boundsMax);
+                    for (int lane = 0; lane < 4; lane++) {
+                        if (!(hits & (1 << lane)))
+                            continue;
+                        unsigned int index = rowLights.lights[l + lane];
+                        const Light& light = viewLights[index];
+                        if (!light.isSpot() || ConeOverlaps(light, center, boundingRadius))
+                            slice.indices.push_back(index);
+                    }
+                }
+                clusterData[cluster * 2] = offset;
+                clusterData[cluster * 2 + 1] = (unsigned int)slice.indices.size() - offset;
+            }
+        }
+    }
+
+    // Tests four spheres against a box. Returns a bit mask of the spheres that overlap it.
+    static int SpheresOverlapBox(const float* x, const float* y, const float* z, const float* radiusSq, glm::vec3 boundsMin, glm::vec3 boundsMax)
+    {
+#ifdef LIGHTING_SSE
+        __m128 zero = _mm_setzero_ps();
+        __m128 distSq = zero;
+
+        __m128 cx = _mm_loadu_ps(x);
+        __m128 dx = _mm_add_ps(_mm_max_ps(zero, _mm_sub_ps(_mm_set1_ps(boundsMin.x), cx)), _mm_max_ps(zero, _mm_sub_ps(cx, _mm_set1_ps(boundsMax.x))));
+        distSq = _mm_add_ps(distSq, _mm_mul_ps(dx, dx));
+
+        __m128 cy = _mm_loadu_ps(y);
+        __m128 dy = _mm_add_ps(_mm_max_ps(zero, _mm_sub_ps(_mm_set1_ps(boundsMin.y), cy)), _mm_max_ps(zero, _mm_sub_ps(cy, _mm_set1_ps(boundsMax.y))));
+        distSq = _mm_add_ps(distSq, _mm_mul_ps(dy, dy));
+
+        __m128 cz = _mm_loadu_ps(z);
+        __m128 dz = _mm_add_ps(_mm_max_ps(zero, _mm_sub_ps(_mm_set1_ps(boundsMin.z), cz)), _mm_max_ps(zero, _mm_sub_ps(cz, _mm_set1_ps(boundsMax.z))));
+        distSq = _mm_add_ps(distSq, _mm_mul_ps(dz, dz));
+
+        return _mm_movemask_ps(_mm_cmple_ps(distSq, _mm_loadu_ps(radiusSq)));
+#else
+        int mask = 0;
+        for (int i = 0; i < 4; i++) {
+            float dx = std::max(0.0f, boundsMin.x - x[i]) + std::max(0.0f, x[i] - boundsMax.x);
+            float dy = std::max(0.0f, boundsMin.y - y[i]) + std::max(0.0f, y[i] - boundsMax.y);
+            float dz = std::max(0.0f, boundsMin.z - z[i]) + std::max(0.0f, z[i] - boundsMax.z);
+            if (dx * dx + dy * dy + dz * dz <= radiusSq[i])
+                mask |= 1 << i;
+        }
+        return mask;
+#endif
+    }
+
+    // Orphans and refills one of the texture buffers
+    void Upload(size_t bytes, const void* data, int buffer)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[buffer].Use());
+        glBufferData(GL_TEXTURE_BUFFER, std::max(bytes, (size_t)16), NULL, GL_STREAM_DRAW);
+        if (bytes)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        buffers[buffer].setSize(std::max(bytes, (size_t)16));
+    }
+};
+
+#endif
@@ -0,0 +1,405 @@
+#ifndef _H_OCCLUSION_
+#define _H_OCCLUSION_
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <mutex>
+#include "Jobs.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_SSE
+#endif
+
+// Per-pass statistics, reset by BeginFrame
+struct OcclusionStats
+{
+    unsigned int occluderTriangles = 0;  // Triangles submitted as occluders
+    unsigned int trianglesSkipped = 0;   // Occluder triangles dropped because the time budget ran out
+    unsigned int visible = 0;            // Bounds that passed the test
+    unsigned int occluded = 0;           // Bounds hidden behind occluders
+    unsigned int outside = 0;            // Bounds entirely off-screen
+    float rasterTime = 0.0f;             // Milliseconds spent rasterizing occluders and building the pyramid
+    float testTime = 0.0f;               // Milliseconds spent testing bounds
+};
+
+// Software occlusion culler. Designated occluder meshes are rasterized on the CPU into a small tiled depth buffer,
+// which is then reduced into a pyramid of the farthest occluder depth per texel. Node bounds are projected to the
+// screen and compared against the coarsest pyramid level that still covers them with a couple of texels, so each test
+// is only a handful of reads. A box is visible as soon as its nearest point is in front of one texel's farthest
+// depth, so a pyramid of nearest depths could never decide a test earlier and isn't built.
+// Everything is conservative: triangles crossing the near plane or dropped because of the time budget simply don't
+// occlude anything.
+class OcclusionCuller
+{
+public:
+    static const int TILE_SIZE = 8;
+
+    OcclusionCuller(int _width = 256, int _height = 192) : timeBudget(1.0f)
+    {
+        Resize(_width, _height);
+    }
+
+    // Changes the depth buffer resolution. Sizes are rounded up to whole tiles.
+    void Resize(int _width, int _height)
+    {
+        tilesX = std::max(1, (_width + TILE_SIZE - 1) / TILE_SIZE);
+        tilesY = std::max(1, (_height + TILE_SIZE - 1) / TILE_SIZE);
+        width = tilesX * TILE_SIZE;
+        height = tilesY * TILE_SIZE;
+        depth.assign((size_t)width * height, 1.0f);
+
+        // Level 0 of the pyramid is already a 2x2 reduction of the depth buffer
+        maxLevels.clear();
+        levelSizes.clear();
+        int w = width, h = height;
+        do {
+            w = std::max(1, (w + 1) / 2);
+            h = std::max(1, (h + 1) / 2);
+            levelSizes.push_back(glm::vec2((float)w, (float)h));
+            maxLevels.push_back(std::vector<float>((size_t)w * h, 1.0f));
+        } while (w > 1 || h > 1);
+    }
+
+    // Starts a new pass. Bounds and occluders given afterwards are transformed by this view-projection matrix
+    void BeginFrame(const glm::mat4& _viewProjection)
+    {
+        viewProjection = _viewProjection;
+        vertices.clear();
+        stats = OcclusionStats();
+    }
+
+    // Adds an occluder mesh as a non-indexed triangle list. The first three floats of each vertex are its position.
+    // Submit the biggest occluders first, since the tail end is what gets dropped when the time budget runs out.
+    void AddOccluder(const float* data, size_t vertexCount, size_t stride, const glm::mat4& model)
+    {
+        glm::mat4 mvp = viewProjection * model;
+        size_t floatsPerVertex = stride / sizeof(float);
+        vertexCount -= vertexCount % 3;
+
+        for (size_t i = 0; i < vertexCount; i++) {
+            const float* p = data + i * floatsPerVertex;
+            vertices.push_back(mvp * glm::vec4(p[0], p[1], p[2], 1.0f));
+        }
+        stats.occluderTriangles += (unsigned int)(vertexCount / 3);
+    }
+
+    // Rasterizes all occluders and builds the depth pyramid. Each tile row is rasterized by a single job, so no
+    // locking is needed on the depth buffer.
+    void Rasterize(JobSystem& jobs)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        auto deadline = start + std::chrono::microseconds((long long)(timeBudget * 1000.0f));
+
+        // Triangle setup is shared by every tile row
+        size_t triangleCount = vertices.size() / 3;
+        triangles.resize(triangleCount);
+        jobs.ParallelFor(triangleCount, 256, [this](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                SetupTriangle(triangles[i], &vertices[i * 3]);
+        });
+
+        std::vector<unsigned int> skipped(tilesY, 0);
+        jobs.ParallelFor(tilesY, 1, [this, deadline, &skipped](size_t begin, size_t end) {
+            for (size_t row = begin; row < end; row++)
+                skipped[row] = RasterizeRow((int)row, deadline);
+        });
+        for (unsigned int s : skipped)
+            stats.trianglesSkipped = std::max(stats.trianglesSkipped, s);
+
+        BuildPyramid(jobs);
+
+        stats.rasterTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // Tests a world space bounding box against the last rasterized pass. Safe to call from several threads at once.
+    bool IsVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        int result = TestBounds(boundsMin, boundsMax);
+        float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.testTime += elapsed;
+        CountResult(result);
+        return result == VISIBLE;
+    }
+
+    // Tests a batch of bounding boxes in parallel. visible[i] is set to 1 when box i may be visible.
+    void TestBatch(JobSystem& jobs, const glm::vec3* boundsMin, const glm::vec3* boundsMax, size_t count, unsigned char* visible)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<int> results(count);
+        jobs.ParallelFor(count, 512, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                results[i] = TestBounds(boundsMin[i], boundsMax[i]);
+                visible[i] = results[i] == VISIBLE;
+            }
+        });
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        for (int result : results)
+            CountResult(result);
+        stats.testTime += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    const OcclusionStats& getStats() const { return stats; }
+
+    // Maximum milliseconds Rasterize may spend on occluder triangles
+    float getTimeBudget() const { return timeBudget; }
+    void setTimeBudget(float _timeBudget) { timeBudget = _timeBudget; }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+private:
+    enum TestResult { VISIBLE, OCCLUDED, OUTSIDE };
+
+    // Screen space triangle ready for rasterization. Edge functions and depth are planes in pixel coordinates.
+    struct Triangle
+    {
+        bool valid;
+        int minX, maxX, minY, maxY;
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+    };
+
+    int width, height;
+    int tilesX, tilesY;
+    float timeBudget;
+    glm::mat4 viewProjection;
+    std::vector<glm::vec4> vertices;
+    std::vector<Triangle> triangles;
+    std::vector<float> depth;                   // Tiled: each TILE_SIZE x TILE_SIZE tile is stored contiguously
+    std::vector<std::vector<float>> maxLevels;  // Farthest occluder depth per texel, used for the tests
+    std::vector<glm::vec2> levelSizes;
+    OcclusionStats stats;
+    std::mutex statsMutex;
+
+    size_t TiledIndex(int x, int y) const
+    {
+        return ((size_t)(y / TILE_SIZE) * tilesX + x / TILE_SIZE) * (TILE_SIZE * TILE_SIZE) + (y % TILE_SIZE) * TILE_SIZE + (x % TILE_SIZE);
+    }
+
+    void CountResult(int result)
+    {
+        if (result == VISIBLE)
+            stats.visible++;
+        else if (result == OCCLUDED)
+            stats.occluded++;
+        else
+            stats.outside++;
+    }
+
+    void SetupTriangle(Triangle& tri, const glm::vec4* clip)
+    {
+        tri.valid = false;
+
+        // Clipping isn't worth it for occluders, anything touching the near plane is just skipped
+        for (int i = 0; i < 3; i++)
+            if (clip[i].w <= 1e-4f || clip[i].z < -clip[i].w)
+                return;
+
+        float x[3], y[3], z[3];
+        for (int i = 0; i < 3; i++) {
+            float invW = 1.0f / clip[i].w;
+            x[i] = (clip[i].x * invW * 0.5f + 0.5f) * width;
+            y[i] = (clip[i].y * invW * 0.5f + 0.5f) * height;
+            z[i] = clip[i].z * invW * 0.5f + 0.5f;
+        }
+
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (std::fabs(area) < 1e-6f)
+            return;
+
+        // Occluders are double sided, so flip clockwise triangles instead of dropping them
+        if (area < 0.0f) {
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+            std::swap(z[1], z[2]);
+            area = -area;
+        }
+
+        // Vertices close to the near plane land far outside the screen, so clamp before converting to int
+        float minX = std::floor(std::min(x[0], std::min(x[1], x[2])));
+        float maxX = std::ceil(std::max(x[0], std::max(x[1], x[2])));
+        float minY = std::floor(std::min(y[0], std::min(y[1], y[2])));
+        float maxY = std::ceil(std::max(y[0], std::max(y[1], y[2])));
+        if (!(maxX >= 0.0f && minX <= width - 1.0f && maxY >= 0.0f && minY <= height - 1.0f))
+            return;
+        tri.minX = (int)std::max(minX, 0.0f);
+        tri.maxX = (int)std::min(maxX, width - 1.0f);
+        tri.minY = (int)std::max(minY, 0.0f);
+        tri.maxY = (int)std::min(maxY, height - 1.0f);
+
+        // Edge i is opposite vertex i and is positive on the inside
+        for (int i = 0; i < 3; i++) {
+            int a = (i + 1) % 3, b = (i + 2) % 3;
+            tri.edgeA[i] = y[a] - y[b];
+            tri.edgeB[i] = x[b] - x[a];
+            tri.edgeC[i] = x[a] * y[b] - x[b] * y[a];
+        }
+
+        // Depth is affine in screen space after the perspective divide
+        float invArea = 1.0f / area;
+        tri.depthA = (z[0] * tri.edgeA[0] + z[1] * tri.edgeA[1] + z[2] * tri.edgeA[2]) * invArea;
+        tri.depthB = (z[0] * tri.edgeB[0] + z[1] * tri.edgeB[1] + z[2] * tri.edgeB[2]) * invArea;
+        tri.depthC = (z[0] * tri.edgeC[0] + z[1] * tri.edgeC[1] + z[2] * tri.edgeC[2]) * invArea;
+        tri.valid = true;
+    }
+
+    // Clears and rasterizes one row of tiles. Returns the number of triangles skipped because of the time budget.
+    template <class Clock>
+    unsigned int RasterizeRow(int row, std::chrono::time_point<Clock> deadline)
+    {
+        float* rowDepth = &depth[(size_t)row * tilesX * TILE_SIZE * TILE_SIZE];
+        std::fill(rowDepth, rowDepth + tilesX * TILE_SIZE * TILE_SIZE, 1.0f);
+
+        int rowMinY = row * TILE_SIZE;
+        int rowMaxY = rowMinY + TILE_SIZE - 1;
+
+        for (size_t t = 0; t < triangles.size(); t++) {
+            // Checking the clock for every triangle would cost more than small triangles do
+            if ((t & 63) == 63 && Clock::now() > deadline)
+                return (unsigned int)(triangles.size() - t);
+
+            const Triangle& tri = triangles[t];
+            if (!tri.valid || tri.maxY < rowMinY || tri.minY > rowMaxY)
+                continue;
+
+            int minY = std::max(tri.minY, rowMinY);
+            int maxY = std::min(tri.maxY, rowMaxY);
+            int minX = tri.minX & ~3;
+
+            for (int y = minY; y <= maxY; y++) {
+                float py = y + 0.5f;
+                for (int x = minX; x <= tri.maxX; x += 4) {
+                    float* dst = &rowDepth[(size_t)(x / TILE_SIZE) * TILE_SIZE * TILE_SIZE + (y % TILE_SIZE) * TILE_SIZE + (x % TILE_SIZE)];
+                    ShadeQuad(tri, (float)x + 0.5f, py, dst);
+                }
+            }
+        }
+        return 0;
+    }
+
+    // Depth tests four horizontally adjacent pixels starting at (px, py)
+    static void ShadeQuad(const Triangle& tri, float px, float py, float* dst)
+    {
+#ifdef OCCLUSION_SSE
+        __m128 x = _mm_add_ps(_mm_set1_ps(px), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+        __m128 y = _mm_set1_ps(py);
+        __m128 zero = _mm_setzero_ps();
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int i = 0; i < 3; i++) {
+            __m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.edgeA[i]), x), _mm_mul_ps(_mm_set1_ps(tri.edgeB[i]), y)), _mm_set1_ps(tri.edgeC[i]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(e, zero));
+        }
+        if (_mm_movemask_ps(inside) == 0)
+            return;
+
+        __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.depthA), x), _mm_mul_ps(_mm_set1_ps(tri.depthB), y)), _mm_set1_ps(tri.depthC));
+        __m128 old = _mm_loadu_ps(dst);
+        __m128 nearest = _mm_min_ps(old, z);
+        _mm_storeu_ps(dst, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+#else
+        for (int i = 0; i < 4; i++) {
+            float x = px + i;
+            bool inside = true;
+            for (int e = 0; e < 3; e++)
+                inside = inside && tri.edgeA[e] * x + tri.edgeB[e] * py + tri.edgeC[e] >= 0.0f;
+            if (!inside)
+                continue;
+            float z = tri.depthA * x + tri.depthB * py + tri.depthC;
+            if (z < dst[i])
+                dst[i] = z;
+        }
+#endif
+    }
+
+    void BuildPyramid(JobSystem& jobs)
+    {
+        // First level reads 2x2 blocks straight out of the tiled depth buffer
+        int w0 = (int)levelSizes[0].x;
+        int h0 = (int)levelSizes[0].y;
+        jobs.ParallelFor(h0, 8, [this, w0](size_t begin, size_t end) {
+            for (int y = (int)begin; y < (int)end; y++) {
+                for (int x = 0; x < w0; x++) {
+                    float a = depth[TiledIndex(x * 2, y * 2)];
+                    float b = depth[TiledIndex(x * 2 + 1, y * 2)];
+                    float c = depth[TiledIndex(x * 2, y * 2 + 1)];
+                    float d = depth[TiledIndex(x * 2 + 1, y * 2 + 1)];
+                    maxLevels[0][(size_t)y * w0 + x] = std::max(std::max(a, b), std::max(c, d));
+                }
+            }
+        });
+
+        // The rest of the levels are small enough that threading them costs more than it saves
+        for (size_t level = 1; level < levelSizes.size(); level++) {
+            int pw = (int)levelSizes[level - 1].x, ph = (int)levelSizes[level - 1].y;
+            int w = (int)levelSizes[level].x, h = (int)levelSizes[level].y;
+            const std::vector<float>& srcMax = maxLevels[level - 1];
+            for (int y = 0; y < h; y++) {
+                for (int x = 0; x < w; x++) {
+                    float farthest = 0.0f;
+                    for (int sy = y * 2; sy <= std::min(y * 2 + 1, ph - 1); sy++) {
+                        for (int sx = x * 2; sx <= std::min(x * 2 + 1, pw - 1); sx++) {
+                            farthest = std::max(farthest, srcMax[(size_t)sy * pw + sx]);
+                        }
+                    }
+                    maxLevels[level][(size_t)y * w + x] = farthest;
+                }
+            }
+        }
+    }
+
+    int TestBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+    {
+        float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearZ = 1.0f;
+        for (int i = 0; i < 8; i++) {
+            glm::vec4 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y, (i & 4) ? boundsMax.z : boundsMin.z, 1.0f);
+            glm::vec4 clip = viewProjection * corner;
+
+            // Crossing the near plane means the camera is practically inside the box
+            if (clip.w <= 1e-4f)
+                return VISIBLE;
+
+            float invW = 1.0f / clip.w;
+            float x = (clip.x * invW * 0.5f + 0.5f) * width;
+            float y = (clip.y * invW * 0.5f + 0.5f) * height;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            nearZ = std::min(nearZ, clip.z * invW * 0.5f + 0.5f);
+        }
+
+        if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height || nearZ > 1.0f)
+            return OUTSIDE;
+        if (nearZ < 0.0f)
+            return VISIBLE;
+
+        // Pick the level where the rectangle is at most about two texels wide
+        float extent = std::max(maxX - minX, maxY - minY) * 0.5f;
+        int level = extent > 1.0f ? (int)std::ceil(std::log2(extent)) - 1 : 0;
+        level = glm::clamp(level, 0, (int)levelSizes.size() - 1);
+
+        int w = (int)levelSizes[level].x, h = (int)levelSizes[level].y;
+        float scale = 1.0f / (float)(2 << level);
+        int x0 = (int)glm::clamp(minX * scale, 0.0f, w - 1.0f);
+        int x1 = (int)glm::clamp(maxX * scale, 0.0f, w - 1.0f);
+        int y0 = (int)glm::clamp(minY * scale, 0.0f, h - 1.0f);
+        int y1 = (int)glm::clamp(maxY * scale, 0.0f, h - 1.0f);
+
+        const std::vector<float>& farthest = maxLevels[level];
+        for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++)
+                if (nearZ <= farthest[(size_t)y * w + x])
+                    return VISIBLE;
+        return OCCLUDED;
+    }
+};
+
+#endif
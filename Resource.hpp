@@ -0,0 +1,337 @@
+#ifndef _H_RESOURCE_
+#define _H_RESOURCE_
+
+#include <glad/glad.h>
+#include <functional>
+#include <list>
+#include <unordered_set>
+#include <iostream>
+
+// Categories used for VRAM accounting
+enum ResourceCategory {
+    RESOURCE_BUFFER,
+    RESOURCE_TEXTURE,
+    RESOURCE_PROGRAM,
+    RESOURCE_SHADER,
+    RESOURCE_VERTEX_ARRAY,
+    RESOURCE_FRAMEBUFFER,
+    RESOURCE_RENDERBUFFER,
+    RESOURCE_QUERY,
+    RESOURCE_CATEGORY_COUNT
+};
+
+inline const char* getResourceCategoryName(ResourceCategory category)
+{
+    static const char* names[RESOURCE_CATEGORY_COUNT] = { "Buffers", "Textures", "Programs", "Shaders", "Vertex arrays", "Framebuffers", "Renderbuffers", "Queries" };
+    return names[category];
+}
+
+// Bookkeeping for a single GL object. Records live on the heap so that handles can be moved around freely
+// while the manager keeps pointing at the same record.
+struct ResourceRecord
+{
+    GLuint name;
+    ResourceCategory category;
+    size_t bytes;                          // Estimated GPU memory while resident
+    unsigned long long lastUsed;           // Frame number of the last Use()
+    bool resident;                         // False once evicted (or released along with the context)
+    bool alive;                            // False after ReleaseAll, the GL object is gone for good
+    GLuint(*create)();                     // Recreates the GL name when reloading an evicted resource
+    void(*destroy)(GLuint);
+    std::function<void(GLuint)> reload;    // Refills a freshly created name, only set for reloadable resources
+    std::list<ResourceRecord*>::iterator lru;
+};
+
+// Tracks every GL object created through a handle, along with estimated GPU memory per object and category.
+// When the total goes over the budget, reloadable resources that haven't been used for the longest time are
+// evicted at the end of the frame and transparently reloaded the next time they are used. Only textures are made
+// reloadable so far: buffers, programs and shaders count against the budget but are never evicted, so a budget below
+// what they need can't be met.
+class ResourceManager
+{
+public:
+    static ResourceManager& Get()
+    {
+        static ResourceManager instance;
+        return instance;
+    }
+
+    ResourceRecord* Register(ResourceCategory category, GLuint name, GLuint(*create)(), void(*destroy)(GLuint))
+    {
+        ResourceRecord* record = new ResourceRecord();
+        record->name = name;
+        record->category = category;
+        record->bytes = 0;
+        record->lastUsed = frame;
+        record->resident = true;
+        record->alive = true;
+        record->create = create;
+        record->destroy = destroy;
+
+        lru.push_front(record);
+        record->lru = lru.begin();
+        records.insert(record);
+        counts[category]++;
+        return record;
+    }
+
+    void Unregister(ResourceRecord* record)
+    {
+        if (record->alive && record->resident)
+            record->destroy(record->name);
+        SetResident(record, false);
+
+        lru.erase(record->lru);
+        records.erase(record);
+        counts[record->category]--;
+        delete record;
+    }
+
+    // Updates the estimated size of a resource, e.g. after glBufferData or glTexImage2D
+    void SetSize(ResourceRecord* record, size_t bytes)
+    {
+        if (record->resident) {
+            categoryBytes[record->category] += bytes - record->bytes;
+            totalBytes += bytes - record->bytes;
+        }
+        record->bytes = bytes;
+    }
+
+    // Marks a resource as used this frame, reloading it first if it was evicted. Returns the current GL name.
+    GLuint Use(ResourceRecord* record)
+    {
+        record->lastUsed = frame;
+        lru.splice(lru.begin(), lru, record->lru);
+
+        if (!record->resident && record->alive && record->reload) {
+            record->name = record->create();
+            record->reload(record->name);
+            SetResident(record, true);
+            reloads++;
+
+            // Reloads stall the frame, lots of them means the budget is too small for the scene
+            #ifdef _DEBUG
+                std::cout << "Reloaded an evicted resource (" << getResourceCategoryName(record->category) << ", " << record->bytes / 1024 << " KiB) in frame " << frame << "\n";
+            #endif
+        }
+        return record->name;
+    }
+
+    // Call once per frame after swapping buffers
+    void EndFrame()
+    {
+        frame++;
+        EnforceBudget();
+    }
+
+    // Evicts least recently used reloadable resources until the total fits the budget. Resources used during the
+    // current frame are never evicted, so a budget that's too small degrades to "keep what's in use".
+    void EnforceBudget()
+    {
+        if (budget == 0)
+            return;
+
+        for (auto it = lru.rbegin(); it != lru.rend() && totalBytes > budget; ++it) {
+            ResourceRecord* record = *it;
+            if (record->lastUsed + 1 >= frame)
+                break;
+            if (!record->resident || !record->reload || !record->alive)
+                continue;
+
+            record->destroy(record->name);
+            record->name = 0;
+            SetResident(record, false);
+            evictions++;
+        }
+    }
+
+    // Deletes every GL object that is still alive. Call this before the context is destroyed; handles that
+    // go out of scope afterwards won't touch GL anymore.
+    void ReleaseAll()
+    {
+        for (ResourceRecord* record : records) {
+            if (record->alive && record->resident)
+                record->destroy(record->name);
+            SetResident(record, false);
+            record->alive = false;
+            record->name = 0;
+        }
+    }
+
+    void PrintStats(std::ostream& out = std::cout) const
+    {
+        out << "GPU memory: " << totalBytes / 1024 << " KiB";
+        if (budget)
+            out << " / " << budget / 1024 << " KiB";
+        out << " (" << evictions << " evictions, " << reloads << " reloads)\n";
+        for (int i = 0; i < RESOURCE_CATEGORY_COUNT; i++)
+            out << "  " << getResourceCategoryName((ResourceCategory)i) << ": " << counts[i] << " objects, " << categoryBytes[i] / 1024 << " KiB\n";
+    }
+
+    // Budget in bytes, 0 disables eviction
+    size_t getBudget() const { return budget; }
+    void setBudget(size_t _budget) { budget = _budget; }
+
+    size_t getTotalBytes() const { return totalBytes; }
+    size_t getCategoryBytes(ResourceCategory category) const { return categoryBytes[category]; }
+    size_t getCategoryCount(ResourceCategory category) const { return counts[category]; }
+    unsigned long long getFrame() const { return frame; }
+    unsigned int getEvictions() const { return evictions; }
+    unsigned int getReloads() const { return reloads; }
+
+private:
+    std::unordered_set<ResourceRecord*> records;
+    std::list<ResourceRecord*> lru;  // Most recently used first
+    size_t categoryBytes[RESOURCE_CATEGORY_COUNT] = {};
+    size_t counts[RESOURCE_CATEGORY_COUNT] = {};
+    size_t totalBytes = 0;
+    size_t budget = 512 * 1024 * 1024;
+    unsigned long long frame = 0;
+    unsigned int evictions = 0;
+    unsigned int reloads = 0;
+
+    ResourceManager() {}
+    ResourceManager(const ResourceManager&) = delete;
+    ResourceManager& operator=(const ResourceManager&) = delete;
+
+    void SetResident(ResourceRecord* record, bool resident)
+    {
+        if (record->resident == resident)
+            return;
+        record->resident = resident;
+        if (resident) {
+            categoryBytes[record->category] += record->bytes;
+            totalBytes += record->bytes;
+        }
+        else {
+            categoryBytes[record->category] -= record->bytes;
+            totalBytes -= record->bytes;
+        }
+    }
+};
+
+// Per object type creation and deletion functions
+struct BufferTraits
+{
+    static const ResourceCategory category = RESOURCE_BUFFER;
+    static GLuint Create() { GLuint name; glGenBuffers(1, &name); return name; }
+    static void Destroy(GLuint name) { glDeleteBuffers(1, &name); }
+};
+struct TextureTraits
+{
+    static const ResourceCategory category = RESOURCE_TEXTURE;
+    static GLuint Create() { GLuint name; glGenTextures(1, &name); return name; }
+    static void Destroy(GLuint name) { glDeleteTextures(1, &name); }
+};
+struct ProgramTraits
+{
+    static const ResourceCategory category = RESOURCE_PROGRAM;
+    static GLuint Create() { return glCreateProgram(); }
+    static void Destroy(GLuint name) { glDeleteProgram(name); }
+};
+struct ShaderTraits
+{
+    // Shader objects need a type, so they are created with glCreateShader and adopted instead
+    static const ResourceCategory category = RESOURCE_SHADER;
+    static GLuint Create() { return 0; }
+    static void Destroy(GLuint name) { glDeleteShader(name); }
+};
+struct VertexArrayTraits
+{
+    static const ResourceCategory category = RESOURCE_VERTEX_ARRAY;
+    static GLuint Create() { GLuint name; glGenVertexArrays(1, &name); return name; }
+    static void Destroy(GLuint name) { glDeleteVertexArrays(1, &name); }
+};
+struct FramebufferTraits
+{
+    static const ResourceCategory category = RESOURCE_FRAMEBUFFER;
+    static GLuint Create() { GLuint name; glGenFramebuffers(1, &name); return name; }
+    static void Destroy(GLuint name) { glDeleteFramebuffers(1, &name); }
+};
+struct RenderbufferTraits
+{
+    static const ResourceCategory category = RESOURCE_RENDERBUFFER;
+    static GLuint Create() { GLuint name; glGenRenderbuffers(1, &name); return name; }
+    static void Destroy(GLuint name) { glDeleteRenderbuffers(1, &name); }
+};
+struct QueryTraits
+{
+    static const ResourceCategory category = RESOURCE_QUERY;
+    static GLuint Create() { GLuint name; glGenQueries(1, &name); return name; }
+    static void Destroy(GLuint name) { glDeleteQueries(1, &name); }
+};
+
+// Move-only owner of a single GL object. The object is deleted when the handle is destroyed or reset.
+template <class Traits>
+class GLHandle
+{
+public:
+    GLHandle() : record(nullptr) {}
+    ~GLHandle(void) { reset(); }
+
+    GLHandle(const GLHandle&) = delete;
+    GLHandle& operator=(const GLHandle&) = delete;
+
+    GLHandle(GLHandle&& other) : record(other.record) { other.record = nullptr; }
+    GLHandle& operator=(GLHandle&& other)
+    {
+        if (this != &other) {
+            reset();
+            record = other.record;
+            other.record = nullptr;
+        }
+        return *this;
+    }
+
+    // Creates a new GL object
+    static GLHandle Create()
+    {
+        return Adopt(Traits::Create());
+    }
+
+    // Takes ownership of an existing GL object
+    static GLHandle Adopt(GLuint name)
+    {
+        GLHandle handle;
+        handle.record = ResourceManager::Get().Register(Traits::category, name, &Traits::Create, &Traits::Destroy);
+        return handle;
+    }
+
+    // Deletes the GL object now
+    void reset()
+    {
+        if (record)
+            ResourceManager::Get().Unregister(record);
+        record = nullptr;
+    }
+
+    // Returns the GL name without counting as a use. May be 0 if the resource is currently evicted.
+    GLuint get() const { return record ? record->name : 0; }
+
+    // Returns the GL name for rendering, reloading the resource if it was evicted
+    GLuint Use() const { return record ? ResourceManager::Get().Use(record) : 0; }
+
+    explicit operator bool() const { return record != nullptr; }
+
+    // Estimated GPU memory used by the object
+    size_t getSize() const { return record ? record->bytes : 0; }
+    void setSize(size_t bytes) { if (record) ResourceManager::Get().SetSize(record, bytes); }
+
+    // Lets the manager evict this resource when over budget. reload is handed a fresh, unbound name and has to refill it.
+    void setReloadable(std::function<void(GLuint)> reload) { if (record) record->reload = reload; }
+    bool isResident() const { return record && record->resident; }
+
+private:
+    ResourceRecord* record;
+};
+
+typedef GLHandle<BufferTraits> BufferHandle;
+typedef GLHandle<TextureTraits> TextureHandle;
+typedef GLHandle<ProgramTraits> ProgramHandle;
+typedef GLHandle<ShaderTraits> ShaderHandle;
+typedef GLHandle<VertexArrayTraits> VertexArrayHandle;
+typedef GLHandle<FramebufferTraits> FramebufferHandle;
+typedef GLHandle<RenderbufferTraits> RenderbufferHandle;
+typedef GLHandle<QueryTraits> QueryHandle;
+
+#endif
@@ -5,46 +5,99 @@
 #include <glm/glm.hpp>
 #include <string>
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <string.h>
+#include "Resource.hpp"
+#include "FileSystem.hpp"
 
-class Shader {
-private:
+// Uniform setters shared by everything that wraps a linked program
+class ShaderUniforms {
+protected:
     GLuint program;
-    GLuint shaderobj;
+
+public:
+    ShaderUniforms() : program(0) {}
+
+    void setBool(const std::string& name, bool value) const
+    {
+        glUniform1i(glGetUniformLocation(program, name.c_str()), (int)value);
+    }
+    void setInt(const std::string& name, int value) const
+    {
+        glUniform1i(glGetUniformLocation(program, name.c_str()), value);
+    }
+    void setFloat(const std::string& name, float value) const
+    {
+        glUniform1f(glGetUniformLocation(program, name.c_str()), value);
+    }
+    void setVec2(const std::string& name, const glm::vec2& value) const
+    {
+        glUniform2fv(glGetUniformLocation(program, name.c_str()), 1, &value[0]);
+    }
+    void setVec2(const std::string& name, float x, float y) const
+    {
+        glUniform2f(glGetUniformLocation(program, name.c_str()), x, y);
+    }
+    void setVec3(const std::string& name, const glm::vec3& value) const
+    {
+        glUniform3fv(glGetUniformLocation(program, name.c_str()), 1, &value[0]);
+    }
+    void setVec3(const std::string& name, float x, float y, float z) const
+    {
+        glUniform3f(glGetUniformLocation(program, name.c_str()), x, y, z);
+    }
+    void setVec4(const std::string& name, const glm::vec4& value) const
+    {
+        glUniform4fv(glGetUniformLocation(program, name.c_str()), 1, &value[0]);
+    }
+    void setVec4(const std::string& name, float x, float y, float z, float w) const
+    {
+        glUniform4f(glGetUniformLocation(program, name.c_str()), x, y, z, w);
+    }
+    void setMat2(const std::string& name, const glm::mat2& mat) const
+    {
+        glUniformMatrix2fv(glGetUniformLocation(program, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat3(const std::string& name, const glm::mat3& mat) const
+    {
+        glUniformMatrix3fv(glGetUniformLocation(program, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(const std::string& name, const glm::mat4& mat) const
+    {
+        glUniformMatrix4fv(glGetUniformLocation(program, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    }
+};
+
+class Shader : public ShaderUniforms {
+private:
+    ProgramHandle ownedProgram;
+    ShaderHandle shaderobj;
     GLenum type;
 
-    std::string ReadFile(const char* path)
+    // Replaces the compiled shader object and attaches the new one to the program
+    void AttachShader(GLuint shader)
     {
-        std::string text;
-        std::ifstream fileStream(path, std::ios::in);
+        if (shaderobj)
+            glDetachShader(program, shaderobj.get());
+        shaderobj = ShaderHandle::Adopt(shader);
+        glAttachShader(program, shader);
+    }
 
-        if (!fileStream.is_open()) {
+    std::string ReadFile(const char* path)
+    {
+        ByteView file = VirtualFileSystem::Get().Read(path);
+        if (!file) {
             std::cerr << "ERROR: Could not open file at " << path << "\n";
             return "";
         }
-
-        std::string line = "";
-        while (!fileStream.eof()) {
-            getline(fileStream, line);
-            text.append(line + "\n");
-        }
-
-        fileStream.close();
-        return text;
+        return file.toString();
     }
 public:
     Shader(GLuint _type)
     {
         type = _type;
-        program = glCreateProgram();
-        shaderobj = 0;
-    }
-    ~Shader(void)
-    {
-        glDeleteShader(shaderobj);
-        if (program) glDeleteProgram(program);
+        ownedProgram = ProgramHandle::Create();
+        program = ownedProgram.get();
     }
 
     void LoadFromFile(const char* path)
@@ -69,16 +122,8 @@ public:
             std::cerr << "ERROR: Problem while compiling shader:" << "\n" << infoLog << "\n"; // TODO: Show if it is vertex or fragment shader
         }
         // Link the program
-        glAttachShader(program, shader);
-        glLinkProgram(program);
-
-        glGetProgramiv(program, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(program, 512, NULL, infoLog);
-            std::cerr << "ERROR: Problem while linking shader:\n" << infoLog << "\n";
-        }
-
-        program = program;
+        AttachShader(shader);
+        Link();
     }
     void LoadFromString(std::string text)
     {
@@ -100,16 +145,8 @@ public:
             std::cerr << "ERROR: Problem while compiling shader:\n" << infoLog << "\n"; // TODO Show if it is vertex or fragment shader
         }
         // Link the program
-        glAttachShader(program, shader);
-        glLinkProgram(program);
-
-        glGetProgramiv(program, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(program, 512, NULL, infoLog);
-            std::cerr << "ERROR: Problem while linking shader:\n" << infoLog << "\n";
-        }
-
-        program = program;
+        AttachShader(shader);
+        Link();
 
         return;
     }
@@ -125,7 +162,7 @@ public:
         int success;
         char infoLog[512];
 
-        glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, shaderCode, strlen(shaderCode));
+        glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, shaderCode, (GLsizei)shaderString.size());
 
         // Specialize the shader (specify the entry point)
         glSpecializeShader(shader, "main", 0, 0, 0);
@@ -138,16 +175,8 @@ public:
         }
 
         // Link the program
-        glAttachShader(program, shader);
-        glLinkProgram(program);
-
-        glGetProgramiv(program, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(program, 512, NULL, infoLog);
-            std::cerr << "ERROR: Problem while linking shader:\n" << infoLog << "\n";
-        }
-
-        shaderobj = shader;
+        AttachShader(shader);
+        Link();
     }
     void LoadFromBinaryString(std::string text)
     {
@@ -159,7 +188,7 @@ public:
         int success;
         char infoLog[512];
 
-        glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, shaderCode, strlen(shaderCode));
+        glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, shaderCode, (GLsizei)text.size());
 
         // Specialize the shader (specify the entry point)
         glSpecializeShader(shader, "main", 0, 0, 0);
@@ -171,16 +200,8 @@ public:
             std::cerr << "ERROR: Problem while compiling shader:\n" << infoLog << "\n"; // TODO Show if it is vertex or fragment shader
         }
         // Link the program
-        glAttachShader(program, shader);
-        glLinkProgram(program);
-
-        glGetProgramiv(program, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(program, 512, NULL, infoLog);
-            std::cerr << "ERROR: Problem while linking shader:\n" << infoLog << "\n";
-        }
-
-        program = program;
+        AttachShader(shader);
+        Link();
     }
 
     void Bind() { glUseProgram(program); }
@@ -188,7 +209,6 @@ public:
 
     void Link()
     {
-        glAttachShader(program, shaderobj);
         glLinkProgram(program);
 
         int success;
@@ -206,60 +226,18 @@ public:
         return program;
     }
 
+    // Moves this shader over to another program. The program isn't owned by this shader, so it can be shared
+    // between several shaders; only the program the shader created for itself is deleted.
     void setProgram(GLuint _program)
     {
-        glDetachShader(program, shaderobj);
-        glDeleteProgram(program);
+        if (shaderobj) {
+            glDetachShader(program, shaderobj.get());
+            glAttachShader(_program, shaderobj.get());
+        }
+        if (ownedProgram.get() != _program)
+            ownedProgram.reset();
         program = _program;
     }
-    void setBool(const std::string& name, bool value) const
-    {
-        glUniform1i(glGetUniformLocation(program, name.c_str()), (int)value);
-    }
-    void setInt(const std::string& name, int value) const
-    {
-        glUniform1i(glGetUniformLocation(program, name.c_str()), value);
-    }
-    void setFloat(const std::string& name, float value) const
-    {
-        glUniform1f(glGetUniformLocation(program, name.c_str()), value);
-    }
-    void setVec2(const std::string& name, const glm::vec2& value) const
-    {
-        glUniform2fv(glGetUniformLocation(program, name.c_str()), 1, &value[0]);
-    }
-    void setVec2(const std::string& name, float x, float y) const
-    {
-        glUniform2f(glGetUniformLocation(program, name.c_str()), x, y);
-    }
-    void setVec3(const std::string& name, const glm::vec3& value) const
-    {
-        glUniform3fv(glGetUniformLocation(program, name.c_str()), 1, &value[0]);
-    }
-    void setVec3(const std::string& name, float x, float y, float z) const
-    {
-        glUniform3f(glGetUniformLocation(program, name.c_str()), x, y, z);
-    }
-    void setVec4(const std::string& name, const glm::vec4& value) const
-    {
-        glUniform4fv(glGetUniformLocation(program, name.c_str()), 1, &value[0]);
-    }
-    void setVec4(const std::string& name, float x, float y, float z, float w) const
-    {
-        glUniform4f(glGetUniformLocation(program, name.c_str()), x, y, z, w);
-    }
-    void setMat2(const std::string& name, const glm::mat2& mat) const
-    {
-        glUniformMatrix2fv(glGetUniformLocation(program, name.c_str()), 1, GL_FALSE, &mat[0][0]);
-    }
-    void setMat3(const std::string& name, const glm::mat3& mat) const
-    {
-        glUniformMatrix3fv(glGetUniformLocation(program, name.c_str()), 1, GL_FALSE, &mat[0][0]);
-    }
-    void setMat4(const std::string& name, const glm::mat4& mat) const
-    {
-        glUniformMatrix4fv(glGetUniformLocation(program, name.c_str()), 1, GL_FALSE, &mat[0][0]);
-    }
 };
 
 #endif
\ No newline at end of file
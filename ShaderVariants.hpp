@@ -0,0 +1,331 @@
+#ifndef _H_SHADER_VARIANTS_
+#define _H_SHADER_VARIANTS_
+
+#include <glad/glad.h>
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <stdint.h>
+#include "Shader.hpp"
+#include "Resource.hpp"
+#include "FileSystem.hpp"
+
+// Feature toggles compiled into shader variants. Each set bit becomes a #define of the same name in both stages.
+enum ShaderFeature {
+    SHADER_TEXTURED = 1 << 0,
+    SHADER_VERTEX_COLOR = 1 << 1,
+    SHADER_INSTANCED = 1 << 2,
+    SHADER_FOG = 1 << 3,
+    SHADER_WIREFRAME = 1 << 4,
+    SHADER_LIGHTING = 1 << 5,
+    SHADER_FEATURE_COUNT = 6
+};
+
+inline const char* getShaderFeatureName(int bit)
+{
+    static const char* names[SHADER_FEATURE_COUNT] = { "TEXTURED", "VERTEX_COLOR", "INSTANCED", "FOG", "WIREFRAME", "LIGHTING" };
+    return bit >= 0 && bit < SHADER_FEATURE_COUNT ? names[bit] : "";
+}
+
+// Looks up a feature by its define name, returns 0 for unknown names
+inline unsigned int getShaderFeature(const std::string& name)
+{
+    for (int i = 0; i < SHADER_FEATURE_COUNT; i++)
+        if (name == getShaderFeatureName(i))
+            return 1u << i;
+    return 0;
+}
+
+// Feature mask as "TEXTURED|FOG", used in log messages
+inline std::string getShaderFeatureString(unsigned int features)
+{
+    std::string text;
+    for (int i = 0; i < SHADER_FEATURE_COUNT; i++) {
+        if (features & (1u << i)) {
+            if (!text.empty())
+                text += "|";
+            text += getShaderFeatureName(i);
+        }
+    }
+    return text.empty() ? "none" : text;
+}
+
+// A linked program for one feature combination
+class ShaderProgram : public ShaderUniforms {
+public:
+    ProgramHandle handle;
+    unsigned int features;
+    float compileTime;  // Milliseconds spent compiling and linking
+    bool valid;
+
+    ShaderProgram() : features(0), compileTime(0.0f), valid(false) {}
+
+    void Bind() { glUseProgram(program); }
+    void Unbind() { glUseProgram(0); }
+
+    GLuint getProgram() const { return program; }
+
+    friend class ShaderCache;
+};
+
+// A source file with its #includes already pasted in
+struct ShaderSource
+{
+    std::string path;
+    std::string text;
+    std::vector<std::string> files;  // Every file pasted into text, indexed by the source string number of #line
+    uint64_t hash;
+};
+
+// Compiles shader permutations on demand and keeps them keyed by (source hash, feature mask). A source pair is
+// only ever compiled for the feature combinations that are actually used, so the renderer can select specialized
+// programs instead of branching on uniforms without compiling every combination at startup.
+class ShaderCache
+{
+public:
+    // Returns the program for the given sources and features, compiling it the first time it is asked for
+    ShaderProgram& Get(const char* vertexPath, const char* fragmentPath, unsigned int features)
+    {
+        const ShaderSource& vertex = LoadSource(vertexPath);
+        const ShaderSource& fragment = LoadSource(fragmentPath);
+
+        VariantKey key;
+        key.vertexHash = vertex.hash;
+        key.fragmentHash = fragment.hash;
+        key.features = features;
+
+        auto it = programs.find(key);
+        if (it != programs.end())
+            return *it->second;
+
+        std::unique_ptr<ShaderProgram> variant(new ShaderProgram());
+        Compile(*variant, vertex, fragment, features);
+        ShaderProgram& result = *variant;
+        programs[key] = std::move(variant);
+        return result;
+    }
+
+    // Compiles every variant listed in a manifest ahead of time. Each line names a vertex shader, a fragment
+    // shader and the features to enable, e.g. "shaders/static.vert shaders/default.frag TEXTURED FOG".
+    // Lines starting with # are comments.
+    void LoadManifest(const char* path)
+    {
+        ByteView file = VirtualFileSystem::Get().Read(path);
+        if (!file) {
+            std::cerr << "ERROR: Could not open shader manifest at " << path << "\n";
+            return;
+        }
+
+        std::istringstream lines(file.toString());
+        std::string line;
+        while (std::getline(lines, line)) {
+            std::istringstream words(line);
+            std::string vertexPath, fragmentPath, feature;
+            if (!(words >> vertexPath) || vertexPath[0] == '#' || !(words >> fragmentPath))
+                continue;
+
+            unsigned int features = 0;
+            while (words >> feature) {
+                unsigned int bit = getShaderFeature(feature);
+                if (!bit)
+                    std::cerr << "ERROR: Unknown shader feature " << feature << " in " << path << "\n";
+                features |= bit;
+            }
+            Get(vertexPath.c_str(), fragmentPath.c_str(), features);
+        }
+    }
+
+    // Drops cached sources so that edited files are read again. Already compiled programs stay valid.
+    void ReloadSources() { sources.clear(); }
+
+    size_t getVariantCount() const { return programs.size(); }
+
+    float getTotalCompileTime() const
+    {
+        float total = 0.0f;
+        for (const auto& entry : programs)
+            total += entry.second->compileTime;
+        return total;
+    }
+
+private:
+    struct VariantKey
+    {
+        uint64_t vertexHash;
+        uint64_t fragmentHash;
+        unsigned int features;
+        bool operator==(const VariantKey& other) const
+        {
+            return vertexHash == other.vertexHash && fragmentHash == other.fragmentHash && features == other.features;
+        }
+    };
+    struct VariantKeyHash
+    {
+        size_t operator()(const VariantKey& key) const
+        {
+            return (size_t)((key.vertexHash * 31 + key.fragmentHash) ^ ((uint64_t)key.features * 0x9E3779B97F4A7C15ull));
+        }
+    };
+
+    std::unordered_map<VariantKey, std::unique_ptr<ShaderProgram>, VariantKeyHash> programs;
+    std::unordered_map<std::string, ShaderSource> sources;
+
+    // FNV-1a
+    static uint64_t Hash(const std::string& text)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : text) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static std::string getDirectory(const std::string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+    }
+
+    const ShaderSource& LoadSource(const std::string& _path)
+    {
+        std::string path = NormalizePath(_path);
+        auto it = sources.find(path);
+        if (it != sources.end())
+            return it->second;
+
+        ShaderSource& source = sources[path];
+        source.path = path;
+        ResolveIncludes(path, source.text, source.files);
+        source.hash = Hash(source.text);
+        return source;
+    }
+
+    // Appends the file to out, replacing #include "file" lines (relative to the including file) with the contents
+    // of that file. Every file is only included once, which also stops include cycles. Pasted files are wrapped in
+    // #line directives that number each file as its index in files, so compiler errors point at the right file and
+    // line.
+    bool ResolveIncludes(const std::string& path, std::string& out, std::vector<std::string>& files)
+    {
+        if (std::find(files.begin(), files.end(), path) != files.end())
+            return true;
+        std::string fileNumber = std::to_string(files.size());
+        files.push_back(path);
+
+        ByteView file = VirtualFileSystem::Get().Read(path);
+        if (!file) {
+            std::cerr << "ERROR: Could not open file at " << path << "\n";
+            return false;
+        }
+
+        if (fileNumber != "0")
+            out += "#line 1 " + fileNumber + "\n";
+
+        std::istringstream lines(file.toString());
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(lines, line)) {
+            lineNumber++;
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            size_t start = line.find_first_not_of(" \t");
+            if (start != std::string::npos && line.compare(start, 8, "#include") == 0) {
+                size_t open = line.find('"', start + 8);
+                size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+                if (close == std::string::npos) {
+                    std::cerr << "ERROR: Malformed #include in " << path << ": " << line << "\n";
+                    out.push_back('\n');
+                    continue;
+                }
+                ResolveIncludes(NormalizePath(getDirectory(path) + line.substr(open + 1, close - open - 1)), out, files);
+                out += "#line " + std::to_string(lineNumber + 1) + " " + fileNumber + "\n";
+                continue;
+            }
+            out.append(line);
+            out.push_back('\n');
+        }
+        return true;
+    }
+
+    // Inserts the feature defines right after the #version line
+    static std::string AddDefines(const std::string& text, unsigned int features)
+    {
+        std::string defines;
+        for (int i = 0; i < SHADER_FEATURE_COUNT; i++)
+            if (features & (1u << i))
+                defines += std::string("#define ") + getShaderFeatureName(i) + " 1\n";
+
+        size_t insertAt = 0;
+        size_t version = text.find("#version");
+        if (version != std::string::npos) {
+            size_t end = text.find('\n', version);
+            insertAt = end == std::string::npos ? text.size() : end + 1;
+        }
+
+        // Keep the line numbers in compiler errors pointing at the original source
+        size_t line = std::count(text.begin(), text.begin() + insertAt, '\n') + 1;
+        return text.substr(0, insertAt) + defines + "#line " + std::to_string(line) + "\n" + text.substr(insertAt);
+    }
+
+    static GLuint CompileStage(GLenum type, const ShaderSource& source, unsigned int features)
+    {
+        GLuint shader = glCreateShader(type);
+        std::string text = AddDefines(source.text, features);
+        const char* shaderCode = text.c_str();
+        glShaderSource(shader, 1, &shaderCode, NULL);
+        glCompileShader(shader);
+
+        int success;
+        char infoLog[512];
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(shader, 512, NULL, infoLog);
+            std::cerr << "ERROR: Problem while compiling " << source.path << " [" << getShaderFeatureString(features) << "]:\n" << infoLog << "\n";
+            for (size_t i = 1; i < source.files.size(); i++)
+                std::cerr << "  Source string " << i << " is " << source.files[i] << "\n";
+        }
+        return shader;
+    }
+
+    static void Compile(ShaderProgram& variant, const ShaderSource& vertex, const ShaderSource& fragment, unsigned int features)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        variant.handle = ProgramHandle::Create();
+        variant.program = variant.handle.get();
+        variant.features = features;
+
+        ShaderHandle vertexShader = ShaderHandle::Adopt(CompileStage(GL_VERTEX_SHADER, vertex, features));
+        ShaderHandle fragmentShader = ShaderHandle::Adopt(CompileStage(GL_FRAGMENT_SHADER, fragment, features));
+        glAttachShader(variant.program, vertexShader.get());
+        glAttachShader(variant.program, fragmentShader.get());
+        glLinkProgram(variant.program);
+
+        // Querying the link status waits for the driver, so the timing covers the whole compile
+        int success;
+        char infoLog[512];
+        glGetProgramiv(variant.program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glGetProgramInfoLog(variant.program, 512, NULL, infoLog);
+            std::cerr << "ERROR: Problem while linking " << vertex.path << " + " << fragment.path << " [" << getShaderFeatureString(features) << "]:\n" << infoLog << "\n";
+        }
+        variant.valid = success != 0;
+
+        // The stages aren't needed once the program is linked
+        glDetachShader(variant.program, vertexShader.get());
+        glDetachShader(variant.program, fragmentShader.get());
+
+        variant.compileTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        #ifdef _DEBUG
+            std::cout << "Compiled shader variant " << vertex.path << " + " << fragment.path << " [" << getShaderFeatureString(features) << "] in " << variant.compileTime << "ms\n";
+        #endif
+    }
+};
+
+#endif
@@ -0,0 +1,552 @@
+#ifndef _H_SPATIAL_
+#define _H_SPATIAL_
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <stdint.h>
+#include "Jobs.hpp"
+
+struct AABB
+{
+    glm::vec3 min;
+    glm::vec3 max;
+
+    AABB() : min(0.0f), max(0.0f) {}
+    AABB(const glm::vec3& _min, const glm::vec3& _max) : min(_min), max(_max) {}
+
+    static AABB FromCenter(const glm::vec3& center, const glm::vec3& extent) { return AABB(center - extent, center + extent); }
+
+    bool Overlaps(const AABB& other) const
+    {
+        return min.x <= other.max.x && max.x >= other.min.x &&
+               min.y <= other.max.y && max.y >= other.min.y &&
+               min.z <= other.max.z && max.z >= other.min.z;
+    }
+
+    bool OverlapsSphere(const glm::vec3& center, float radius) const
+    {
+        glm::vec3 offset = center - glm::clamp(center, min, max);
+        return glm::dot(offset, offset) <= radius * radius;
+    }
+
+    // Slab test. tEnter is negative if the origin is inside the box, axis is the axis of the entered face.
+    bool IntersectRay(const glm::vec3& origin, const glm::vec3& direction, float& tEnter, float& tExit, int& axis) const
+    {
+        tEnter = -INFINITY;
+        tExit = INFINITY;
+        axis = 0;
+        for (int i = 0; i < 3; i++) {
+            if (direction[i] == 0.0f) {
+                if (origin[i] < min[i] || origin[i] > max[i])
+                    return false;
+                continue;
+            }
+            float t0 = (min[i] - origin[i]) / direction[i];
+            float t1 = (max[i] - origin[i]) / direction[i];
+            if (t0 > t1)
+                std::swap(t0, t1);
+            if (t0 > tEnter) {
+                tEnter = t0;
+                axis = i;
+            }
+            tExit = std::min(tExit, t1);
+        }
+        return tEnter <= tExit && tExit >= 0.0f;
+    }
+};
+
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 direction;  // Normalized
+    float maxDistance;
+
+    Ray() : origin(0.0f), direction(0.0f, 0.0f, -1.0f), maxDistance(1000.0f) {}
+    Ray(const glm::vec3& _origin, const glm::vec3& _direction, float _maxDistance = 1000.0f)
+        : origin(_origin), direction(_direction), maxDistance(_maxDistance) {}
+};
+
+struct RayHit
+{
+    uint32_t body;      // INVALID_BODY if nothing was hit
+    float distance;
+    glm::vec3 normal;   // Face of the box that was hit
+};
+
+struct Sphere
+{
+    glm::vec3 center;
+    float radius;
+};
+
+struct BodyPair
+{
+    uint32_t a, b;  // a < b
+};
+
+// Statistics of the latest FindPairs
+struct SpatialStats
+{
+    unsigned int bodies = 0;
+    unsigned int cellMoves = 0;        // Updates since the last FindPairs that moved a body to other cells
+    unsigned long long pairsTested = 0; // Candidate pairs that got a bounds test
+    unsigned int pairsFound = 0;       // Overlapping pairs
+    float pairTime = 0.0f;             // Milliseconds spent finding pairs
+};
+
+const uint32_t INVALID_BODY = 0xFFFFFFFF;
+
+// Broadphase over axis aligned boxes. Space is split into a uniform grid of cubic cells that is never stored as
+// such: cells are hashed into a fixed number of buckets, each listing the bodies that touch a cell hashing there, so
+// the world can be any size and only occupied cells cost memory. Moving a body only touches the buckets when it
+// enters or leaves a cell, which keeps per-frame updates cheap for many dynamic bodies.
+//
+// Every overlapping pair shares at least one cell. To report each pair once, it is only reported from the cell that
+// holds the minimum corner of the two boxes' intersection, which is also the cell the larger of their minimum cells
+// points to; overlap queries use the same rule. Pairs are found bucket by bucket, and bucket entries carry their cell
+// so that bodies which only share a bucket through a hash collision are skipped without being looked at. Works best
+// with a cell size around the size of a typical body.
+class SpatialGrid
+{
+public:
+    SpatialGrid(float _cellSize = 2.0f, size_t bucketCount = 4096) : bodyCount(0), cellMoves(0), hasBounds(false)
+    {
+        setCellSize(_cellSize);
+        Rehash(bucketCount);
+    }
+
+    // Adds a body and returns its id. Ids of removed bodies are reused.
+    uint32_t Insert(const AABB& bounds)
+    {
+        uint32_t id;
+        if (!freeIds.empty()) {
+            id = freeIds.back();
+            freeIds.pop_back();
+        }
+        else {
+            id = (uint32_t)bodies.size();
+            bodies.push_back(Body());
+        }
+
+        Body& body = bodies[id];
+        body.bounds = bounds;
+        body.cellMin = getCell(bounds.min);
+        body.cellMax = getCell(bounds.max);
+        body.alive = true;
+        bodyCount++;
+        GrowBounds(bounds);
+
+        // Keep buckets short as the body count grows
+        if (bodyCount > buckets.size())
+            Rehash(buckets.size() * 2);
+        else
+            AddToCells(id);
+        return id;
+    }
+
+    void Remove(uint32_t id)
+    {
+        if (id >= bodies.size() || !bodies[id].alive)
+            return;
+        RemoveFromCells(id);
+        bodies[id].alive = false;
+        freeIds.push_back(id);
+        bodyCount--;
+    }
+
+    // Moves a body. Only touches the buckets if the body now covers other cells.
+    void Update(uint32_t id, const AABB& bounds)
+    {
+        if (id >= bodies.size() || !bodies[id].alive)
+            return;
+        Body& body = bodies[id];
+        body.bounds = bounds;
+        GrowBounds(bounds);
+
+        glm::ivec3 cellMin = getCell(bounds.min);
+        glm::ivec3 cellMax = getCell(bounds.max);
+        if (cellMin == body.cellMin && cellMax == body.cellMax)
+            return;
+
+        RemoveFromCells(id);
+        body.cellMin = cellMin;
+        body.cellMax = cellMax;
+        AddToCells(id);
+        cellMoves++;
+    }
+
+    // Collects every pair of overlapping bodies
+    void FindPairs(std::vector<BodyPair>& pairs)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        pairs.clear();
+        unsigned long long tested = FindPairs(0, buckets.size(), pairs);
+        FinishPairs(start, tested, pairs.size());
+    }
+
+    // Same as above, with the buckets split over the job system
+    void FindPairs(std::vector<BodyPair>& pairs, JobSystem& jobs)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        const size_t chunkSize = 4096;
+        size_t chunkCount = (buckets.size() + chunkSize - 1) / chunkSize;
+        chunkPairs.resize(chunkCount);
+        chunkTested.assign(chunkCount, 0);
+
+        jobs.ParallelFor(chunkCount, 1, [this, chunkSize](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++) {
+                chunkPairs[chunk].clear();
+                size_t first = chunk * chunkSize;
+                size_t last = std::min(buckets.size(), (chunk + 1) * chunkSize);
+                chunkTested[chunk] = FindPairs(first, last, chunkPairs[chunk]);
+            }
+        });
+
+        pairs.clear();
+        unsigned long long tested = 0;
+        for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+            pairs.insert(pairs.end(), chunkPairs[chunk].begin(), chunkPairs[chunk].end());
+            tested += chunkTested[chunk];
+        }
+        FinishPairs(start, tested, pairs.size());
+    }
+
+    // Finds the closest body along the ray by walking the cells it passes through in order
+    bool Raycast(const Ray& ray, RayHit& hit) const
+    {
+        hit.body = INVALID_BODY;
+        hit.distance = ray.maxDistance;
+        hit.normal = glm::vec3(0.0f);
+
+        // Only walk the part of the ray inside the space bodies have been in
+        float tEnter, tExit;
+        int axis;
+        if (!hasBounds || !bounds.IntersectRay(ray.origin, ray.direction, tEnter, tExit, axis) || tEnter > ray.maxDistance)
+            return false;
+        tEnter = std::max(tEnter, 0.0f);
+        tExit = std::min(tExit, ray.maxDistance);
+
+        // Amanatides & Woo traversal
+        glm::vec3 start = ray.origin + ray.direction * tEnter;
+        glm::ivec3 cell = glm::clamp(getCell(start), getCell(bounds.min), getCell(bounds.max));
+        glm::ivec3 step;
+        glm::vec3 tNext, tDelta;
+        for (int i = 0; i < 3; i++) {
+            if (ray.direction[i] > 0.0f) {
+                step[i] = 1;
+                tNext[i] = ((cell[i] + 1) * cellSize - ray.origin[i]) / ray.direction[i];
+                tDelta[i] = cellSize / ray.direction[i];
+            }
+            else if (ray.direction[i] < 0.0f) {
+                step[i] = -1;
+                tNext[i] = (cell[i] * cellSize - ray.origin[i]) / ray.direction[i];
+                tDelta[i] = -cellSize / ray.direction[i];
+            }
+            else {
+                step[i] = 0;
+                tNext[i] = INFINITY;
+                tDelta[i] = INFINITY;
+            }
+        }
+
+        while (true) {
+            for (const Entry& entry : buckets[getBucket(cell)]) {
+                if (entry.cell != cell)
+                    continue;
+                const Body& body = bodies[entry.id];
+                float t0, t1;
+                if (body.bounds.IntersectRay(ray.origin, ray.direction, t0, t1, axis) && t0 < hit.distance && t1 >= 0.0f) {
+                    hit.body = entry.id;
+                    hit.distance = std::max(t0, 0.0f);
+                    hit.normal = glm::vec3(0.0f);
+                    hit.normal[axis] = ray.direction[axis] > 0.0f ? -1.0f : 1.0f;
+                }
+            }
+
+            // Nothing in later cells can be closer than a hit before the next cell boundary
+            int next = tNext.x < tNext.y ? (tNext.x < tNext.z ? 0 : 2) : (tNext.y < tNext.z ? 1 : 2);
+            if (hit.distance <= tNext[next] || tNext[next] > tExit)
+                break;
+            cell[next] += step[next];
+            tNext[next] += tDelta[next];
+        }
+        return hit.body != INVALID_BODY;
+    }
+
+    // Appends the bodies overlapping the box
+    void OverlapBox(const AABB& box, std::vector<uint32_t>& results) const
+    {
+        Overlap(box, results, [&box](const AABB& bounds) { return bounds.Overlaps(box); });
+    }
+
+    // Appends the bodies overlapping the sphere
+    void OverlapSphere(const glm::vec3& center, float radius, std::vector<uint32_t>& results) const
+    {
+        AABB box = AABB::FromCenter(center, glm::vec3(radius));
+        Overlap(box, results, [&center, radius](const AABB& bounds) { return bounds.OverlapsSphere(center, radius); });
+    }
+
+    // Batched versions of the queries above, spread over the job system. results are resized to the query count.
+    void RaycastBatch(const std::vector<Ray>& rays, std::vector<RayHit>& hits, JobSystem& jobs) const
+    {
+        hits.resize(rays.size());
+        jobs.ParallelFor(rays.size(), 64, [this, &rays, &hits](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                Raycast(rays[i], hits[i]);
+        });
+    }
+    void OverlapBoxBatch(const std::vector<AABB>& boxes, std::vector<std::vector<uint32_t>>& results, JobSystem& jobs) const
+    {
+        results.resize(boxes.size());
+        jobs.ParallelFor(boxes.size(), 64, [this, &boxes, &results](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                results[i].clear();
+                OverlapBox(boxes[i], results[i]);
+            }
+        });
+    }
+    void OverlapSphereBatch(const std::vector<Sphere>& spheres, std::vector<std::vector<uint32_t>>& results, JobSystem& jobs) const
+    {
+        results.resize(spheres.size());
+        jobs.ParallelFor(spheres.size(), 64, [this, &spheres, &results](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                results[i].clear();
+                OverlapSphere(spheres[i].center, spheres[i].radius, results[i]);
+            }
+        });
+    }
+
+    // Moves a sphere from one position to another and returns where it ends up, pushed out of every body it runs
+    // into so that it slides along them. The move is split into steps shorter than the radius so it can't tunnel
+    // through thin bodies. A sphere without a radius, or one that doesn't move, goes straight to the target.
+    glm::vec3 SlideSphere(const glm::vec3& from, const glm::vec3& to, float radius) const
+    {
+        glm::vec3 position = from;
+        glm::vec3 move = to - from;
+        float length = glm::length(move);
+        if (radius <= 0.0f || length == 0.0f)
+            return to;
+        int steps = std::max(1, (int)ceil(length / (radius * 0.5f)));
+        std::vector<uint32_t> touching;
+        for (int i = 0; i < steps; i++) {
+            position += move / (float)steps;
+
+            // A few passes, pushing out of one body may push into another
+            for (int pass = 0; pass < 4; pass++) {
+                touching.clear();
+                OverlapSphere(position, radius, touching);
+                if (touching.empty())
+                    break;
+                for (uint32_t id : touching)
+                    position += getPushOut(bodies[id].bounds, position, radius);
+            }
+        }
+        return position;
+    }
+
+    const AABB& getBounds(uint32_t id) const { return bodies[id].bounds; }
+    bool isAlive(uint32_t id) const { return id < bodies.size() && bodies[id].alive; }
+
+    // One past the highest id in use, for iterating over bodies together with isAlive
+    uint32_t getIdLimit() const { return (uint32_t)bodies.size(); }
+    unsigned int getBodyCount() const { return bodyCount; }
+
+    // Changing the cell size rebuilds the buckets
+    float getCellSize() const { return cellSize; }
+    void setCellSize(float _cellSize)
+    {
+        cellSize = _cellSize;
+        invCellSize = 1.0f / _cellSize;
+        if (!buckets.empty())
+            Rehash(buckets.size());
+    }
+
+    const SpatialStats& getStats() const { return stats; }
+
+private:
+    struct Body
+    {
+        AABB bounds;
+        glm::ivec3 cellMin, cellMax;
+        bool alive;
+    };
+
+    float cellSize;
+    float invCellSize;
+    std::vector<Body> bodies;
+    std::vector<uint32_t> freeIds;
+    // A body in one of the cells hashing to a bucket. The body's first cell is copied in so the reporting cell of a
+    // pair can be checked without looking at the bodies.
+    struct Entry
+    {
+        uint32_t id;
+        glm::ivec3 cell;
+        glm::ivec3 cellMin;
+    };
+
+    std::vector<std::vector<Entry>> buckets;  // The count is a power of two
+    size_t bucketMask;
+    unsigned int bodyCount;
+    unsigned int cellMoves;
+    AABB bounds;  // Everything bodies have been in, only ever grows
+    bool hasBounds;
+
+    // Per-chunk results of the threaded FindPairs
+    std::vector<std::vector<BodyPair>> chunkPairs;
+    std::vector<unsigned long long> chunkTested;
+    SpatialStats stats;
+
+    glm::ivec3 getCell(const glm::vec3& position) const
+    {
+        return glm::ivec3(glm::floor(position * invCellSize));
+    }
+
+    size_t getBucket(const glm::ivec3& cell) const
+    {
+        return ((uint32_t)cell.x * 73856093u ^ (uint32_t)cell.y * 19349663u ^ (uint32_t)cell.z * 83492791u) & bucketMask;
+    }
+
+    void AddToCells(uint32_t id)
+    {
+        const Body& body = bodies[id];
+        for (int z = body.cellMin.z; z <= body.cellMax.z; z++) {
+            for (int y = body.cellMin.y; y <= body.cellMax.y; y++) {
+                for (int x = body.cellMin.x; x <= body.cellMax.x; x++) {
+                    glm::ivec3 cell(x, y, z);
+                    buckets[getBucket(cell)].push_back({ id, cell, body.cellMin });
+                }
+            }
+        }
+    }
+
+    void RemoveFromCells(uint32_t id)
+    {
+        const Body& body = bodies[id];
+        for (int z = body.cellMin.z; z <= body.cellMax.z; z++) {
+            for (int y = body.cellMin.y; y <= body.cellMax.y; y++) {
+                for (int x = body.cellMin.x; x <= body.cellMax.x; x++) {
+                    glm::ivec3 cell(x, y, z);
+                    std::vector<Entry>& bucket = buckets[getBucket(cell)];
+                    auto it = std::find_if(bucket.begin(), bucket.end(), [id, &cell](const Entry& entry) { return entry.id == id && entry.cell == cell; });
+                    if (it != bucket.end()) {
+                        *it = bucket.back();
+                        bucket.pop_back();
+                    }
+                }
+            }
+        }
+    }
+
+    // Rounds up to a power of two and reinserts every body
+    void Rehash(size_t bucketCount)
+    {
+        size_t count = 1;
+        while (count < bucketCount)
+            count *= 2;
+        buckets.assign(count, std::vector<Entry>());
+        bucketMask = count - 1;
+        for (uint32_t id = 0; id < bodies.size(); id++) {
+            if (bodies[id].alive) {
+                bodies[id].cellMin = getCell(bodies[id].bounds.min);
+                bodies[id].cellMax = getCell(bodies[id].bounds.max);
+                AddToCells(id);
+            }
+        }
+    }
+
+    void GrowBounds(const AABB& box)
+    {
+        if (!hasBounds) {
+            bounds = box;
+            hasBounds = true;
+        }
+        bounds.min = glm::min(bounds.min, box.min);
+        bounds.max = glm::max(bounds.max, box.max);
+    }
+
+    // Pairs sharing a cell in the buckets [first, last). Returns the number of bounds tests.
+    unsigned long long FindPairs(size_t first, size_t last, std::vector<BodyPair>& pairs) const
+    {
+        unsigned long long tested = 0;
+        for (size_t i = first; i < last; i++) {
+            const std::vector<Entry>& bucket = buckets[i];
+            for (size_t j = 0; j + 1 < bucket.size(); j++) {
+                const Entry& a = bucket[j];
+                for (size_t k = j + 1; k < bucket.size(); k++) {
+                    // Only the pair's reporting cell tests it
+                    const Entry& b = bucket[k];
+                    if (b.cell != a.cell || glm::max(a.cellMin, b.cellMin) != a.cell)
+                        continue;
+                    tested++;
+                    if (bodies[a.id].bounds.Overlaps(bodies[b.id].bounds))
+                        pairs.push_back({ std::min(a.id, b.id), std::max(a.id, b.id) });
+                }
+            }
+        }
+        return tested;
+    }
+
+    void FinishPairs(std::chrono::high_resolution_clock::time_point start, unsigned long long tested, size_t found)
+    {
+        stats.bodies = bodyCount;
+        stats.cellMoves = cellMoves;
+        stats.pairsTested = tested;
+        stats.pairsFound = (unsigned int)found;
+        stats.pairTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        cellMoves = 0;
+    }
+
+    // Visits the cells under the box and appends the bodies passing test, each once
+    template <class Test>
+    void Overlap(const AABB& box, std::vector<uint32_t>& results, Test test) const
+    {
+        if (!hasBounds)
+            return;
+        glm::ivec3 cellMin = glm::max(getCell(box.min), getCell(bounds.min));
+        glm::ivec3 cellMax = glm::min(getCell(box.max), getCell(bounds.max));
+        for (int z = cellMin.z; z <= cellMax.z; z++) {
+            for (int y = cellMin.y; y <= cellMax.y; y++) {
+                for (int x = cellMin.x; x <= cellMax.x; x++) {
+                    glm::ivec3 cell(x, y, z);
+                    for (const Entry& entry : buckets[getBucket(cell)]) {
+                        if (entry.cell == cell && glm::max(cellMin, entry.cellMin) == cell && test(bodies[entry.id].bounds))
+                            results.push_back(entry.id);
+                    }
+                }
+            }
+        }
+    }
+
+    // Smallest move that gets a sphere out of a box
+    static glm::vec3 getPushOut(const AABB& box, const glm::vec3& center, float radius)
+    {
+        glm::vec3 offset = center - glm::clamp(center, box.min, box.max);
+        float distance = glm::length(offset);
+        if (distance > 0.0f)
+            return distance < radius ? offset * ((radius - distance) / distance) : glm::vec3(0.0f);
+
+        // The center is inside, leave through the closest face
+        glm::vec3 push(0.0f);
+        float best = INFINITY;
+        for (int i = 0; i < 3; i++) {
+            float down = center[i] - box.min[i];
+            float up = box.max[i] - center[i];
+            if (down < best) {
+                best = down;
+                push = glm::vec3(0.0f);
+                push[i] = -(down + radius);
+            }
+            if (up < best) {
+                best = up;
+                push = glm::vec3(0.0f);
+                push[i] = up + radius;
+            }
+        }
+        return push;
+    }
+};
+
+#endif
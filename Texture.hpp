@@ -2,6 +2,8 @@
 #define _H_TEXTURE_
 
 #include "util.hpp"
+#include "Resource.hpp"
+#include "FileSystem.hpp"
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 #include <glad/glad.h>
@@ -11,26 +13,66 @@
 class Texture
 {
 public:
-    unsigned int textureid;
+    TextureHandle texture;
     int width, height;
     const char* path;
     std::string type;
 
     Texture(const char* _path, std::string _type = "texture_diffuse") // Texture types: texture_diffuse, texture_specular, texture_normal, texture_height
     {
-        glGenTextures(1, &textureid);
-        glBindTexture(GL_TEXTURE_2D, textureid);
+        path = _path;
+        type = _type;
+        width = height = 0;
+        texture = TextureHandle::Create();
+
+        int nrChannels = Upload(texture.get(), _path, &width, &height);
+        if (nrChannels)
+        {
+            // Base level plus roughly a third for the mipmap chain
+            texture.setSize((size_t)width * height * nrChannels * 4 / 3);
+
+            // The pixels can be read from disk again, so the texture may be evicted when VRAM runs low
+            std::string reloadPath = _path;
+            texture.setReloadable([reloadPath](GLuint name) {
+                int w, h;
+                Upload(name, reloadPath.c_str(), &w, &h);
+            });
+        }
+        else
+        {
+            std::cerr << "ERROR: Couldn't load texture at " << path << std::endl;
+        }
+    }
+
+    // Binds the texture to the given texture unit, reloading it first if it was evicted
+    void Bind(unsigned int unit = 0) const
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture.Use());
+    }
+
+    unsigned int getID() const { return texture.get(); }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+private:
+    // Loads the image at _path into the texture name. Returns the number of channels, or 0 if loading failed.
+    static int Upload(GLuint name, const char* _path, int* _width, int* _height)
+    {
+        glBindTexture(GL_TEXTURE_2D, name);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        int nrChannels;
-        path = _path;
-        type = _type;
-        unsigned char* data = stbi_load(_path, &width, &height, &nrChannels, 0);
+        int nrChannels = 0;
+        unsigned char* data = nullptr;
+        ByteView file = VirtualFileSystem::Get().Read(_path);
+        if (file && !file.empty())
+            data = stbi_load_from_memory(file.data, (int)file.size, _width, _height, &nrChannels, 0);
         if (data)
         {
-            GLenum format;
+            GLenum format = GL_RGB;
             if (nrChannels == 1)
                 format = GL_RED;
             else if (nrChannels == 3)
@@ -38,8 +80,7 @@ public:
             else if (nrChannels == 4)
                 format = GL_RGBA;
 
-            glBindTexture(GL_TEXTURE_2D, textureid);
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, *_width, *_height, 0, format, GL_UNSIGNED_BYTE, data);
             glGenerateMipmap(GL_TEXTURE_2D);
 
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat 
@@ -49,15 +90,11 @@ public:
         }
         else
         {
-            std::cerr << "ERROR: Couldn't load texture at " << path << std::endl;
+            nrChannels = 0;
         }
         stbi_image_free(data);
+        return nrChannels;
     }
-
-    unsigned int getID() const { return textureid; }
-
-    int getWidth() const { return width; }
-    int getHeight() const { return height; }
 };
 
 #endif
\ No newline at end of file
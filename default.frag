@@ -4,9 +4,28 @@ out vec4 FragColor;
 in vec3 outColor;
 in vec2 outTexCoord;
 
+#include "fog.glsl"
+#include "lighting.glsl"
+
 uniform sampler2D Texture;
 
 void main()
 {
-    FragColor = texture(Texture, outTexCoord);
+#ifdef WIREFRAME
+    FragColor = vec4(0.0, 1.0, 0.0, 1.0);
+#else
+#ifdef TEXTURED
+    vec4 color = texture(Texture, outTexCoord);
+#else
+    vec4 color = vec4(1.0);
+#endif
+    color.rgb *= outColor;
+#ifdef LIGHTING
+    color.rgb = applyLighting(color.rgb);
+#endif
+#ifdef FOG
+    color.rgb = applyFog(color.rgb);
+#endif
+    FragColor = color;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,14 @@
+#ifdef FOG
+in float outViewDepth;
+
+uniform vec3 fogColor;
+uniform float fogStart;
+uniform float fogEnd;
+
+// Linear distance fog
+vec3 applyFog(vec3 color)
+{
+    float amount = clamp((outViewDepth - fogStart) / (fogEnd - fogStart), 0.0, 1.0);
+    return mix(color, fogColor, amount);
+}
+#endif
@@ -0,0 +1,48 @@
+#ifdef LIGHTING
+in vec3 outViewPos;
+
+uniform samplerBuffer lightData;     // Three texels per light: position and radius, color and outer cone cosine, direction and inner cone cosine
+uniform usamplerBuffer clusterData;  // Offset into lightIndices and light count per cluster
+uniform usamplerBuffer lightIndices;
+uniform vec3 clusterGrid;
+uniform vec2 clusterDepthParams;     // Scale and bias that turn log(depth) into a depth slice
+uniform vec2 viewportSize;
+uniform vec3 ambientLight;
+
+// Diffuse lighting from the lights binned into this fragment's cluster. All positions are in view space.
+vec3 applyLighting(vec3 color)
+{
+    // Flat normal from the screen space derivatives, there are no vertex normals yet
+    vec3 normal = normalize(cross(dFdx(outViewPos), dFdy(outViewPos)));
+
+    float slice = clamp(floor(log(-outViewPos.z) * clusterDepthParams.x + clusterDepthParams.y), 0.0, clusterGrid.z - 1.0);
+    vec2 tile = clamp(floor(gl_FragCoord.xy / viewportSize * clusterGrid.xy), vec2(0.0), clusterGrid.xy - 1.0);
+    int cluster = int((slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x);
+    uvec2 range = texelFetch(clusterData, cluster).xy;
+
+    vec3 lighting = ambientLight;
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).x) * 3;
+        vec4 positionRadius = texelFetch(lightData, light);
+        vec4 colorCone = texelFetch(lightData, light + 1);
+
+        vec3 toLight = positionRadius.xyz - outViewPos;
+        float distance = length(toLight);
+        if (distance >= positionRadius.w)
+            continue;
+        vec3 direction = toLight / distance;
+
+        // Inverse square falloff, windowed so it reaches zero at the radius
+        float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (distance * distance + 1.0);
+
+        if (colorCone.w > -1.0) {
+            vec4 spotDirection = texelFetch(lightData, light + 2);
+            attenuation *= smoothstep(colorCone.w, spotDirection.w, dot(-direction, spotDirection.xyz));
+        }
+
+        lighting += colorCone.rgb * max(dot(normal, direction), 0.0) * attenuation;
+    }
+    return color * lighting;
+}
+#endif
@@ -10,9 +10,18 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "util.hpp"
+#include "FileSystem.hpp"
 #include "Shader.hpp"
+#include "ShaderVariants.hpp"
 #include "Texture.hpp"
 #include "Camera.hpp"
+#include "Resource.hpp"
+#include "Jobs.hpp"
+#include "Occlusion.hpp"
+#include "Lighting.hpp"
+#include "DynamicResolution.hpp"
+#include "Spatial.hpp"
+#include "GLCapture.hpp"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processEvents(GLFWwindow* window, float deltatime);
@@ -23,7 +32,13 @@ const unsigned int WIN_HEIGHT = 600;
 const char* WIN_NAME = "Node Game Engine";
 unsigned int MAX_FPS = 30;
 
+// Size of the window's framebuffer, kept up to date by framebuffer_size_callback
+int windowWidth = WIN_WIDTH;
+int windowHeight = WIN_HEIGHT;
+
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+const float CAMERA_RADIUS = 0.2f;
+SpatialGrid world;  // Collision bounds of everything the camera can bump into
 bool firstMouse = 1;
 float lastMouseX = (float)WIN_WIDTH / 2.0f;
 float lastMouseY = (float)WIN_HEIGHT / 2.0f;
@@ -71,6 +86,11 @@ int main()
 		return -1;
 	}
 
+	// Record GL calls from here on so that F12 can save a replayable trace of a frame
+	#ifdef _CAPTURE
+		GLCapture::Get().Install();
+	#endif
+
 	#ifdef _DEBUG
 		std::cout << "Initialized GLAD\n";
 		std::cout << "OpenGL Version: " << glGetString(GL_VERSION) << "\n";
@@ -85,29 +105,41 @@ int main()
 
 	stbi_set_flip_vertically_on_load(true);
 	glEnable(GL_DEPTH_TEST);
-	glViewport(0, 0, WIN_WIDTH, WIN_HEIGHT);
+	glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+	glViewport(0, 0, windowWidth, windowHeight);
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	glfwSetCursorPosCallback(window, mouse_callback);
 
-	// ==================== Load Shaders ===================
+	// ==================== Mount Assets ===================
 
-	GLuint program = glCreateProgram();
-
-	Shader vertexShader = Shader(GL_VERTEX_SHADER);
-	Shader fragmentShader = Shader(GL_FRAGMENT_SHADER);
+	// Shaders and textures are read from assets.pak (built with tools/PackBuilder), which is mapped once instead of
+	// opening every file on its own. Without a pack, and always in debug builds, loose files are used instead.
+	bool packMounted = VirtualFileSystem::Get().Mount("assets.pak");
+	#ifdef _DEBUG
+		std::cout << (packMounted ? "Mounted assets.pak\n" : "No asset pack, using loose files\n");
+		VirtualFileSystem::Get().AddOverrideDirectory("");
+	#else
+		if (!packMounted)
+			VirtualFileSystem::Get().AddOverrideDirectory("");
+	#endif
 
-	//glDeleteProgram(vertexShader.getProgram());
-	//glDeleteProgram(fragmentShader.getProgram());
+	// ==================== Load Shaders ===================
 
-	vertexShader.setProgram(program);
-	fragmentShader.setProgram(program);
+	// Variants listed in the manifest are compiled now, anything else on first use
+	ShaderCache shaders;
+	shaders.LoadManifest("shaders/variants.txt");
 
-	vertexShader.LoadFromFile("shaders/static.vert");
-	fragmentShader.LoadFromFile("shaders/default.frag");
+	#ifdef _WIREFRAME
+		unsigned int shaderFeatures = SHADER_WIREFRAME;
+	#else
+		unsigned int shaderFeatures = SHADER_TEXTURED | SHADER_LIGHTING;
+	#endif
+	ShaderProgram& shader = shaders.Get("shaders/static.vert", "shaders/default.frag", shaderFeatures);
+	ShaderProgram& upscaleShader = shaders.Get("shaders/blit.vert", "shaders/upscale.frag", 0);
 
-	vertexShader.Link();
-	fragmentShader.Link();
+	// Debug builds list every variant as it compiles, this is the total for the startup set in every build
+	std::cout << "Compiled " << shaders.getVariantCount() << " shader variants in " << shaders.getTotalCompileTime() << "ms\n";
 
 
 	// ================ Creating game objects ==============
@@ -155,14 +187,14 @@ int main()
 		-0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
 		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f
 	};
-	unsigned int VBO, VAO;
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
+	VertexArrayHandle VAO = VertexArrayHandle::Create();
+	BufferHandle VBO = BufferHandle::Create();
 
-	glBindVertexArray(VAO);
+	glBindVertexArray(VAO.get());
 
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO.get());
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	VBO.setSize(sizeof(vertices));
 
 	// position attribute
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -172,13 +204,41 @@ int main()
 	glEnableVertexAttribArray(1);
 
 	Texture tex = Texture("assets/container.jpg");
-	fragmentShader.Bind();
-	fragmentShader.setInt("Texture", 0);
+
+	// Bounds of the cube, big enough to hold it at any rotation, so they never need updating
+	glm::vec3 cubeExtent = glm::vec3(0.87f);
+	world.Insert(AABB(-cubeExtent, cubeExtent));
+
+	// A wall behind the cube with a second cube hidden behind it, so the occlusion culler has something to do
+	glm::vec3 wallPosition = glm::vec3(0.0f, 0.0f, -2.5f);
+	glm::vec3 wallExtent = glm::vec3(2.0f, 1.5f, 0.1f);
+	glm::mat4 wallModel = glm::scale(glm::translate(glm::mat4(1.0f), wallPosition), wallExtent * 2.0f);
+	world.Insert(AABB(wallPosition - wallExtent, wallPosition + wallExtent));
+	glm::vec3 hiddenPosition = glm::vec3(0.0f, 0.0f, -5.0f);
+	world.Insert(AABB(hiddenPosition - cubeExtent, hiddenPosition + cubeExtent));
+	shader.Bind();
+	shader.setInt("Texture", 0);
 
 	#ifdef _WIREFRAME
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 	#endif
 
+	// ================== Engine subsystems ================
+
+	JobSystem jobs;
+	OcclusionCuller occlusion;
+	ClusteredLighting lighting;
+
+	// The scene is rendered at a lower resolution when the GPU can't keep up with the frame rate
+	DynamicResolution resolution(upscaleShader, 1000.0f / MAX_FPS);
+
+	// A few colored lights circling the cube, plus a flashlight on the camera
+	std::vector<Light> lights;
+	glm::vec3 lightColors[] = { glm::vec3(1.0f, 0.3f, 0.2f), glm::vec3(0.2f, 1.0f, 0.3f), glm::vec3(0.3f, 0.4f, 1.0f), glm::vec3(1.0f, 0.9f, 0.5f) };
+	for (const glm::vec3& color : lightColors)
+		lights.push_back(Light::Point(glm::vec3(0.0f), 4.0f, color, 3.0f));
+	lights.push_back(Light::Spot(camera.position, camera.front, 10.0f, 15.0f, 25.0f, glm::vec3(1.0f), 2.0f));
+
 	// ===================== Game loop =====================
 
 	#ifdef _DEBUG
@@ -205,36 +265,78 @@ int main()
 		// This was using too much of the CPU
 		#ifdef _DEBUG
 			eraseLines(1);
-			std::cout << "FPS: " << (int)FPS << "\n";
+			const OcclusionStats& occlusionStats = occlusion.getStats();
+			std::cout << "FPS: " << (int)FPS << " | Visible: " << occlusionStats.visible << " Occluded: " << occlusionStats.occluded
+				<< " Occlusion pass: " << occlusionStats.rasterTime + occlusionStats.testTime << "ms"
+				<< " | Lights: " << lighting.getStats().lights << " Binning: " << lighting.getStats().binningTime << "ms"
+				<< " | Resolution: " << (int)(resolution.getStats().scale * 100.0f) << "% GPU: " << resolution.getStats().gpuTime << "ms\n";
 		#endif
 
 		// Input and clearing
 		processEvents(window, deltatime);
+		resolution.BeginFrame(windowWidth, windowHeight);
 		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Create necessary matrices
 		glm::mat4 model = glm::mat4(1.0f);
 		model = glm::rotate(model, (float)glfwGetTime(), glm::vec3(1.5f, 2.9f, 0.8f)); 
-		glm::mat4 projection = glm::perspective(glm::radians(camera.FOV), (float)WIN_WIDTH / (float)WIN_HEIGHT, 0.1f, 100.0f);
-		fragmentShader.setMat4("projection", projection);
+		glm::mat4 projection = glm::perspective(glm::radians(camera.FOV), resolution.getAspect(), 0.1f, 100.0f);
+		shader.Bind();
+		shader.setMat4("projection", projection);
 		glm::mat4 view = camera.GetViewMatrix();
-		fragmentShader.setMat4("view", view);
-		fragmentShader.setMat4("model", model);
+		shader.setMat4("view", view);
+
+		// Move the lights and bin them into clusters
+		for (size_t i = 0; i + 1 < lights.size(); i++) {
+			float angle = (float)glfwGetTime() + i * glm::radians(90.0f);
+			lights[i].position = glm::vec3(cos(angle) * 1.5f, sin(angle * 0.5f), sin(angle) * 1.5f);
+		}
+		lights.back().position = camera.position;
+		lights.back().direction = camera.front;
+		lighting.Update(lights, view, camera.FOV, resolution.getAspect(), 0.1f, 100.0f, jobs);
+		lighting.Bind(shader, (float)resolution.getRenderWidth(), (float)resolution.getRenderHeight());
+
+		// Occlusion culling. Occluders have to be added between BeginFrame and Rasterize
+		occlusion.BeginFrame(projection * view);
+		occlusion.AddOccluder(vertices, 36, 5 * sizeof(float), wallModel);
+		occlusion.Rasterize(jobs);
 
 		// Render
-		glBindVertexArray(VAO);
+		tex.Bind(0);
+		glBindVertexArray(VAO.Use());
+		shader.setMat4("model", wallModel);
 		glDrawArrays(GL_TRIANGLES, 0, 36);
-
-		// Swap buffers
+		if (occlusion.IsVisible(-cubeExtent, cubeExtent))
+		{
+			shader.setMat4("model", model);
+			glDrawArrays(GL_TRIANGLES, 0, 36);
+		}
+		if (occlusion.IsVisible(hiddenPosition - cubeExtent, hiddenPosition + cubeExtent))
+		{
+			shader.setMat4("model", glm::translate(glm::mat4(1.0f), hiddenPosition) * model);
+			glDrawArrays(GL_TRIANGLES, 0, 36);
+		}
+
+		// Upscale to the window and swap buffers
+		resolution.Present();
 		glfwSwapBuffers(window);
+		#ifdef _CAPTURE
+			GLCapture::Get().EndFrame();
+		#endif
 		glfwPollEvents();
+		ResourceManager::Get().EndFrame();
 	}
 
 	// ===================== Close everything up =====================
 
-	vertexShader.~Shader();
-	fragmentShader.~Shader();
+	#ifdef _DEBUG
+		ResourceManager::Get().PrintStats();
+	#endif
+
+	// Handles still in scope are destroyed after the context is gone, so free their GL objects now
+	ResourceManager::Get().ReleaseAll();
+	VirtualFileSystem::Get().UnmountAll();
 
 	glfwTerminate();
 	return 0;
@@ -242,7 +344,9 @@ int main()
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-	glViewport(0, 0, width, height);
+	// The viewport is set every frame by DynamicResolution, which also resizes its render target
+	windowWidth = width;
+	windowHeight = height;
 }
 
 void processEvents(GLFWwindow* window, float deltatime)
@@ -250,6 +354,7 @@ void processEvents(GLFWwindow* window, float deltatime)
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
 
+	glm::vec3 start = camera.position;
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
 		camera.position += camera.speed * camera.front * deltatime;
 	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
@@ -263,6 +368,20 @@ void processEvents(GLFWwindow* window, float deltatime)
 		camera.position.y += camera.speed * deltatime;
 	if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
 		camera.position.y -= camera.speed * deltatime;
+
+	// Slide along whatever the move runs into instead of passing through it
+	camera.position = world.SlideSphere(start, camera.position, CAMERA_RADIUS);
+
+	#ifdef _CAPTURE
+		// Capture the next frame once per press
+		static bool captureHeld = false;
+		bool capturePressed = glfwGetKey(window, GLFW_KEY_F12) == GLFW_PRESS;
+		if (capturePressed && !captureHeld && !GLCapture::Get().isCapturing())
+		{
+			GLCapture::Get().RequestCapture("capture.trace", windowWidth, windowHeight);
+		}
+		captureHeld = capturePressed;
+	#endif
 }
 
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
@@ -1,9 +1,21 @@
 #version 330 core
 layout (location = 0) in vec3 Pos;
 layout (location = 1) in vec2 TexCoord;
+#ifdef VERTEX_COLOR
+layout (location = 2) in vec3 Color;
+#endif
+#ifdef INSTANCED
+layout (location = 3) in mat4 instanceModel; // Takes up locations 3 to 6
+#endif
 
 out vec3 outColor;
 out vec2 outTexCoord;
+#ifdef FOG
+out float outViewDepth;
+#endif
+#ifdef LIGHTING
+out vec3 outViewPos;
+#endif
 
 uniform mat4 model;
 uniform mat4 view;
@@ -11,6 +23,22 @@ uniform mat4 projection;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(Pos, 1.0);
+#ifdef INSTANCED
+    vec4 viewPos = view * instanceModel * vec4(Pos, 1.0);
+#else
+    vec4 viewPos = view * model * vec4(Pos, 1.0);
+#endif
+    gl_Position = projection * viewPos;
     outTexCoord = vec2(TexCoord.x, TexCoord.y);
+#ifdef VERTEX_COLOR
+    outColor = Color;
+#else
+    outColor = vec3(1.0);
+#endif
+#ifdef FOG
+    outViewDepth = -viewPos.z;
+#endif
+#ifdef LIGHTING
+    outViewPos = viewPos.xyz;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,652 @@
+// Plays back a trace written by GLCapture on an offscreen context and reports where the time goes.
+//
+// Usage: GLReplay <trace> [--loops N] [--warmup N] [--screenshot out.ppm]
+//
+// The context is created through EGL without a window, so this also runs on headless machines, e.g. with Mesa's
+// llvmpipe (LIBGL_ALWAYS_SOFTWARE=1). The captured frame is rendered into an offscreen framebuffer of the captured
+// size, which stands in for the default framebuffer. On Linux:
+//   g++ -std=c++14 -O2 -I<glad include> tools/GLReplay.cpp glad.c -lEGL -ldl -o GLReplay
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <chrono>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "../FileSystem.hpp"
+#include "../GLCapture.hpp"
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+struct TraceRecord
+{
+	uint16_t op;
+	uint16_t argCount;
+	const uint32_t* args;
+	const unsigned char* blob;
+	uint32_t blobSize;
+};
+
+// Splits the mapped trace into records. The arguments and blobs point straight into the mapping.
+static bool parseTrace(ByteView trace, TraceHeader& header, std::vector<TraceRecord>& records)
+{
+	if (trace.size < sizeof(TraceHeader))
+		return false;
+	memcpy(&header, trace.data, sizeof(header));
+	if (header.magic != TRACE_MAGIC || header.version != TRACE_VERSION)
+		return false;
+
+	size_t offset = sizeof(TraceHeader);
+	size_t count = (size_t)header.prologueCount + header.frameCount;
+	records.reserve(count);
+	for (size_t i = 0; i < count; i++) {
+		if (offset + 8 > trace.size)
+			return false;
+		TraceRecord record;
+		memcpy(&record.op, trace.data + offset, 2);
+		memcpy(&record.argCount, trace.data + offset + 2, 2);
+		memcpy(&record.blobSize, trace.data + offset + 4, 4);
+		offset += 8;
+		if (record.op >= TRACE_OP_COUNT || record.argCount > 10 || offset + record.argCount * 4 + (size_t)record.blobSize > trace.size)
+			return false;
+		record.args = (const uint32_t*)(trace.data + offset);
+		offset += record.argCount * 4;
+		record.blob = trace.data + offset;
+		offset += (record.blobSize + 3) / 4 * 4;
+		records.push_back(record);
+	}
+	return true;
+}
+
+// Executes records against the current context, remapping object names and uniform locations
+class Replayer
+{
+public:
+	Replayer(GLuint _output) : output(_output), readFramebuffer(_output), drawFramebuffer(_output) {}
+
+	void Execute(const TraceRecord& r)
+	{
+		const uint32_t* a = r.args;
+		if (framing && getDeleteOp(r.op) != TRACE_OP_COUNT)
+			frameObjects.push_back(std::make_pair(getDeleteOp(r.op), a[0]));
+		switch (r.op) {
+		// The prologue only keeps the latest upload of each object, which may come after the object is first referenced
+		// (e.g. by glTexBuffer). Generated names only become objects once bound, so buffers and renderbuffers are
+		// bound right away. Textures need their target, they are created in FramebufferTexture2D if necessary.
+		case TRACE_GEN_BUFFER: {
+			GLuint n;
+			glGenBuffers(1, &n);
+			names[TRACE_NS_BUFFER][a[0]] = n;
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[GL_COPY_WRITE_BUFFER] = n);
+			break;
+		}
+		case TRACE_GEN_TEXTURE: { GLuint n; glGenTextures(1, &n); names[TRACE_NS_TEXTURE][a[0]] = n; break; }
+		case TRACE_GEN_VERTEX_ARRAY: { GLuint n; glGenVertexArrays(1, &n); names[TRACE_NS_VERTEX_ARRAY][a[0]] = n; break; }
+		case TRACE_GEN_FRAMEBUFFER: { GLuint n; glGenFramebuffers(1, &n); names[TRACE_NS_FRAMEBUFFER][a[0]] = n; break; }
+		case TRACE_GEN_RENDERBUFFER: {
+			GLuint n;
+			glGenRenderbuffers(1, &n);
+			names[TRACE_NS_RENDERBUFFER][a[0]] = n;
+			glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer = n);
+			break;
+		}
+		case TRACE_CREATE_SHADER: names[TRACE_NS_PROGRAM][a[0]] = glCreateShader(a[1]); break;
+		case TRACE_CREATE_PROGRAM: names[TRACE_NS_PROGRAM][a[0]] = glCreateProgram(); break;
+
+		case TRACE_DELETE_BUFFER: {
+			GLuint n = Forget(TRACE_NS_BUFFER, a[0]);
+			for (auto& binding : buffers)
+				if (binding.second == n)
+					binding.second = 0;
+			glDeleteBuffers(1, &n);
+			break;
+		}
+		case TRACE_DELETE_TEXTURE: {
+			GLuint n = Forget(TRACE_NS_TEXTURE, a[0]);
+			createdTextures.erase(n);
+			for (auto& binding : textures)
+				if (binding.second == n)
+					binding.second = 0;
+			glDeleteTextures(1, &n);
+			break;
+		}
+		case TRACE_DELETE_VERTEX_ARRAY: {
+			GLuint n = Forget(TRACE_NS_VERTEX_ARRAY, a[0]);
+			if (vertexArray == n)
+				vertexArray = 0;
+			glDeleteVertexArrays(1, &n);
+			break;
+		}
+		case TRACE_DELETE_FRAMEBUFFER: {
+			GLuint n = Forget(TRACE_NS_FRAMEBUFFER, a[0]);
+			if (readFramebuffer == n)
+				readFramebuffer = output;
+			if (drawFramebuffer == n)
+				drawFramebuffer = output;
+			glDeleteFramebuffers(1, &n);
+			// Deleting a bound framebuffer falls back to the default one, which is ours
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+			break;
+		}
+		case TRACE_DELETE_RENDERBUFFER: {
+			GLuint n = Forget(TRACE_NS_RENDERBUFFER, a[0]);
+			if (renderbuffer == n)
+				renderbuffer = 0;
+			glDeleteRenderbuffers(1, &n);
+			break;
+		}
+		case TRACE_DELETE_SHADER: glDeleteShader(Forget(TRACE_NS_PROGRAM, a[0])); break;
+		case TRACE_DELETE_PROGRAM: glDeleteProgram(Forget(TRACE_NS_PROGRAM, a[0])); break;
+
+		case TRACE_SHADER_SOURCE: {
+			const GLchar* source = (const GLchar*)r.blob;
+			GLint length = (GLint)r.blobSize;
+			glShaderSource(Name(TRACE_NS_PROGRAM, a[0]), 1, &source, &length);
+			break;
+		}
+		case TRACE_SHADER_BINARY: {
+			GLuint shader = Name(TRACE_NS_PROGRAM, a[0]);
+			glShaderBinary(1, &shader, a[1], r.blob, (GLsizei)r.blobSize);
+			break;
+		}
+		case TRACE_SPECIALIZE_SHADER: {
+			const GLchar* entryPoint = (const GLchar*)r.blob;
+			size_t entryLength = strlen(entryPoint) + 1;
+			std::vector<GLuint> constants(a[1] * 2);
+			if (!constants.empty())
+				memcpy(&constants[0], r.blob + entryLength, constants.size() * sizeof(GLuint));
+			glSpecializeShader(Name(TRACE_NS_PROGRAM, a[0]), entryPoint, a[1], constants.data(), constants.data() + a[1]);
+			break;
+		}
+		case TRACE_COMPILE_SHADER: glCompileShader(Name(TRACE_NS_PROGRAM, a[0])); break;
+		case TRACE_ATTACH_SHADER: glAttachShader(Name(TRACE_NS_PROGRAM, a[0]), Name(TRACE_NS_PROGRAM, a[1])); break;
+		case TRACE_DETACH_SHADER: glDetachShader(Name(TRACE_NS_PROGRAM, a[0]), Name(TRACE_NS_PROGRAM, a[1])); break;
+		case TRACE_LINK_PROGRAM: glLinkProgram(Name(TRACE_NS_PROGRAM, a[0])); break;
+		case TRACE_GET_UNIFORM_LOCATION: {
+			std::string name((const char*)r.blob, r.blobSize);
+			locations[LocationKey(a[0], a[1])] = glGetUniformLocation(Name(TRACE_NS_PROGRAM, a[0]), name.c_str());
+			break;
+		}
+		case TRACE_USE_PROGRAM: program = Name(TRACE_NS_PROGRAM, a[0]); glUseProgram(program); break;
+
+		case TRACE_UNIFORM_1I: UseProgram(a[0]); glUniform1i(Location(a[0], a[1]), (GLint)a[2]); break;
+		case TRACE_UNIFORM_1F: UseProgram(a[0]); glUniform1f(Location(a[0], a[1]), Float(a[2])); break;
+		case TRACE_UNIFORM_2F: UseProgram(a[0]); glUniform2f(Location(a[0], a[1]), Float(a[2]), Float(a[3])); break;
+		case TRACE_UNIFORM_3F: UseProgram(a[0]); glUniform3f(Location(a[0], a[1]), Float(a[2]), Float(a[3]), Float(a[4])); break;
+		case TRACE_UNIFORM_4F: UseProgram(a[0]); glUniform4f(Location(a[0], a[1]), Float(a[2]), Float(a[3]), Float(a[4]), Float(a[5])); break;
+		case TRACE_UNIFORM_2FV: UseProgram(a[0]); glUniform2fv(Location(a[0], a[1]), a[2], Floats(r)); break;
+		case TRACE_UNIFORM_3FV: UseProgram(a[0]); glUniform3fv(Location(a[0], a[1]), a[2], Floats(r)); break;
+		case TRACE_UNIFORM_4FV: UseProgram(a[0]); glUniform4fv(Location(a[0], a[1]), a[2], Floats(r)); break;
+		case TRACE_UNIFORM_MATRIX_2FV: UseProgram(a[0]); glUniformMatrix2fv(Location(a[0], a[1]), a[2], (GLboolean)a[3], Floats(r)); break;
+		case TRACE_UNIFORM_MATRIX_3FV: UseProgram(a[0]); glUniformMatrix3fv(Location(a[0], a[1]), a[2], (GLboolean)a[3], Floats(r)); break;
+		case TRACE_UNIFORM_MATRIX_4FV: UseProgram(a[0]); glUniformMatrix4fv(Location(a[0], a[1]), a[2], (GLboolean)a[3], Floats(r)); break;
+
+		case TRACE_BIND_BUFFER: {
+			GLuint n = Name(TRACE_NS_BUFFER, a[1]);
+			if (a[0] != GL_ELEMENT_ARRAY_BUFFER)
+				buffers[a[0]] = n;
+			glBindBuffer(a[0], n);
+			break;
+		}
+		case TRACE_BUFFER_DATA:
+			BindBuffer(a[1], a[0]);
+			glBufferData(a[1], a[2], r.blobSize ? r.blob : NULL, a[3]);
+			break;
+		case TRACE_BUFFER_SUB_DATA:
+			BindBuffer(a[3], a[0]);
+			glBufferSubData(a[3], a[1], a[2], r.blob);
+			break;
+		case TRACE_ELEMENT_BUFFER:
+			BindVertexArray(a[0]);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Name(TRACE_NS_BUFFER, a[1]));
+			break;
+
+		case TRACE_ACTIVE_TEXTURE: activeTexture = a[0]; glActiveTexture(a[0]); break;
+		case TRACE_BIND_TEXTURE: {
+			GLuint n = Name(TRACE_NS_TEXTURE, a[1]);
+			textures[TextureKey(activeTexture, a[0])] = n;
+			createdTextures.insert(n);
+			glBindTexture(a[0], n);
+			break;
+		}
+		case TRACE_TEX_IMAGE_2D:
+			BindTexture(a[1], a[0]);
+			if ((GLint)a[8] != unpackAlignment) {
+				unpackAlignment = (GLint)a[8];
+				glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+			}
+			glTexImage2D(a[1], a[2], a[3], a[4], a[5], 0, a[6], a[7], r.blobSize ? r.blob : NULL);
+			break;
+		case TRACE_TEX_PARAMETER_I: BindTexture(a[2], a[0]); glTexParameteri(a[2], a[1], (GLint)a[3]); break;
+		case TRACE_GENERATE_MIPMAP: BindTexture(a[1], a[0]); glGenerateMipmap(a[1]); break;
+		case TRACE_TEX_BUFFER: BindTexture(a[1], a[0]); glTexBuffer(a[1], a[2], Name(TRACE_NS_BUFFER, a[3])); break;
+
+		case TRACE_BIND_VERTEX_ARRAY: vertexArray = Name(TRACE_NS_VERTEX_ARRAY, a[0]); glBindVertexArray(vertexArray); break;
+		case TRACE_VERTEX_ATTRIB_POINTER:
+			BindVertexArray(a[0]);
+			BindBuffer(GL_ARRAY_BUFFER, a[2]);
+			glVertexAttribPointer(a[1], a[3], a[4], (GLboolean)a[5], a[6], (const void*)(uintptr_t)a[7]);
+			break;
+		case TRACE_ENABLE_VERTEX_ATTRIB: BindVertexArray(a[0]); glEnableVertexAttribArray(a[1]); break;
+		case TRACE_DISABLE_VERTEX_ATTRIB: BindVertexArray(a[0]); glDisableVertexAttribArray(a[1]); break;
+
+		case TRACE_BIND_FRAMEBUFFER: {
+			GLuint n = Framebuffer(a[1]);
+			if (a[0] != GL_DRAW_FRAMEBUFFER)
+				readFramebuffer = n;
+			if (a[0] != GL_READ_FRAMEBUFFER)
+				drawFramebuffer = n;
+			glBindFramebuffer(a[0], n);
+			break;
+		}
+		case TRACE_BIND_RENDERBUFFER: renderbuffer = Name(TRACE_NS_RENDERBUFFER, a[1]); glBindRenderbuffer(a[0], renderbuffer); break;
+		case TRACE_FRAMEBUFFER_TEXTURE_2D:
+			CreateTexture(a[3], a[4]);
+			BindFramebuffer(a[2], a[0]);
+			glFramebufferTexture2D(a[2], a[1], a[3], Name(TRACE_NS_TEXTURE, a[4]), a[5]);
+			break;
+		case TRACE_FRAMEBUFFER_RENDERBUFFER:
+			BindFramebuffer(a[2], a[0]);
+			glFramebufferRenderbuffer(a[2], a[1], a[3], Name(TRACE_NS_RENDERBUFFER, a[4]));
+			break;
+		case TRACE_RENDERBUFFER_STORAGE: {
+			GLuint n = Name(TRACE_NS_RENDERBUFFER, a[0]);
+			if (renderbuffer != n)
+				glBindRenderbuffer(a[1], renderbuffer = n);
+			glRenderbufferStorage(a[1], a[2], a[3], a[4]);
+			break;
+		}
+		case TRACE_BLIT_FRAMEBUFFER: glBlitFramebuffer(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9]); break;
+
+		case TRACE_ENABLE: glEnable(a[0]); break;
+		case TRACE_DISABLE: glDisable(a[0]); break;
+		case TRACE_VIEWPORT: glViewport(a[0], a[1], a[2], a[3]); break;
+		case TRACE_SCISSOR: glScissor(a[0], a[1], a[2], a[3]); break;
+		case TRACE_CLEAR_COLOR: glClearColor(Float(a[0]), Float(a[1]), Float(a[2]), Float(a[3])); break;
+		case TRACE_DEPTH_FUNC: glDepthFunc(a[0]); break;
+		case TRACE_BLEND_FUNC: glBlendFunc(a[0], a[1]); break;
+		case TRACE_CULL_FACE: glCullFace(a[0]); break;
+		case TRACE_POLYGON_MODE: glPolygonMode(a[0], a[1]); break;
+
+		case TRACE_CLEAR: glClear(a[0]); break;
+		case TRACE_DRAW_ARRAYS: glDrawArrays(a[0], a[1], a[2]); break;
+		case TRACE_DRAW_ARRAYS_INSTANCED: glDrawArraysInstanced(a[0], a[1], a[2], a[3]); break;
+		case TRACE_DRAW_ELEMENTS: glDrawElements(a[0], a[1], a[2], (const void*)(uintptr_t)a[3]); break;
+		case TRACE_DRAW_ELEMENTS_INSTANCED: glDrawElementsInstanced(a[0], a[1], a[2], (const void*)(uintptr_t)a[3], a[4]); break;
+		}
+	}
+
+	// Objects created by the frame are deleted again when it ends, so that every loop creates them anew like the
+	// captured frame did instead of piling up
+	void BeginFrame() { framing = true; }
+	void EndFrame()
+	{
+		framing = false;
+		for (auto it = frameObjects.rbegin(); it != frameObjects.rend(); ++it) {
+			TraceRecord r = {};
+			r.op = it->first;
+			r.argCount = 1;
+			r.args = &it->second;
+			if (names[getTraceOpInfo(r.op).object].count(it->second))
+				Execute(r);
+		}
+		frameObjects.clear();
+	}
+
+private:
+	GLuint output;
+	bool framing = false;
+	std::vector<std::pair<uint16_t, uint32_t>> frameObjects;
+	std::unordered_map<uint32_t, GLuint> names[TRACE_NS_COUNT];
+	std::unordered_map<uint64_t, GLint> locations;
+
+	// Bindings on our side. Binds recorded in the trace are always executed, but the binds that the recorded calls
+	// imply are skipped when the object is already bound.
+	GLuint program = 0, vertexArray = 0, readFramebuffer, drawFramebuffer, renderbuffer = 0;
+	GLenum activeTexture = GL_TEXTURE0;
+	GLint unpackAlignment = 4;
+	std::unordered_map<GLenum, GLuint> buffers;
+	std::unordered_map<uint64_t, GLuint> textures;
+	std::unordered_set<GLuint> createdTextures;
+
+	// The call that deletes what the given call creates, TRACE_OP_COUNT for calls that don't create objects
+	static uint16_t getDeleteOp(uint16_t op)
+	{
+		switch (op) {
+		case TRACE_GEN_BUFFER: return TRACE_DELETE_BUFFER;
+		case TRACE_GEN_TEXTURE: return TRACE_DELETE_TEXTURE;
+		case TRACE_GEN_VERTEX_ARRAY: return TRACE_DELETE_VERTEX_ARRAY;
+		case TRACE_GEN_FRAMEBUFFER: return TRACE_DELETE_FRAMEBUFFER;
+		case TRACE_GEN_RENDERBUFFER: return TRACE_DELETE_RENDERBUFFER;
+		case TRACE_CREATE_SHADER: return TRACE_DELETE_SHADER;
+		case TRACE_CREATE_PROGRAM: return TRACE_DELETE_PROGRAM;
+		default: return TRACE_OP_COUNT;
+		}
+	}
+
+	static float Float(uint32_t bits) { float value; memcpy(&value, &bits, 4); return value; }
+	static const GLfloat* Floats(const TraceRecord& r) { return (const GLfloat*)r.blob; }
+	static uint64_t LocationKey(uint32_t program, uint32_t location) { return ((uint64_t)program << 32) | location; }
+	static uint64_t TextureKey(GLenum unit, GLenum target) { return ((uint64_t)unit << 32) | target; }
+
+	GLuint Name(int ns, uint32_t recorded) const
+	{
+		if (recorded == 0)
+			return 0;
+		auto it = names[ns].find(recorded);
+		return it == names[ns].end() ? 0 : it->second;
+	}
+
+	GLuint Forget(int ns, uint32_t recorded)
+	{
+		GLuint name = Name(ns, recorded);
+		names[ns].erase(recorded);
+		return name;
+	}
+
+	// The captured default framebuffer is our offscreen one
+	GLuint Framebuffer(uint32_t recorded) const { return recorded ? Name(TRACE_NS_FRAMEBUFFER, recorded) : output; }
+
+	GLint Location(uint32_t program, uint32_t location) const
+	{
+		auto it = locations.find(LocationKey(program, location));
+		return it == locations.end() ? -1 : it->second;
+	}
+
+	void UseProgram(uint32_t recorded)
+	{
+		GLuint n = Name(TRACE_NS_PROGRAM, recorded);
+		if (program != n)
+			glUseProgram(program = n);
+	}
+
+	void BindBuffer(GLenum target, uint32_t recorded)
+	{
+		GLuint n = Name(TRACE_NS_BUFFER, recorded);
+		if (target == GL_ELEMENT_ARRAY_BUFFER) {
+			glBindBuffer(target, n);
+			return;
+		}
+		auto it = buffers.find(target);
+		if (it == buffers.end() || it->second != n) {
+			buffers[target] = n;
+			glBindBuffer(target, n);
+		}
+	}
+
+	void BindTexture(GLenum target, uint32_t recorded)
+	{
+		if (target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z)
+			target = GL_TEXTURE_CUBE_MAP;
+		GLuint n = Name(TRACE_NS_TEXTURE, recorded);
+		auto it = textures.find(TextureKey(activeTexture, target));
+		if (it == textures.end() || it->second != n) {
+			textures[TextureKey(activeTexture, target)] = n;
+			createdTextures.insert(n);
+			glBindTexture(target, n);
+		}
+	}
+
+	// Binds a texture that hasn't been bound yet once, without changing the current bindings
+	void CreateTexture(GLenum target, uint32_t recorded)
+	{
+		if (target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z)
+			target = GL_TEXTURE_CUBE_MAP;
+		GLuint n = Name(TRACE_NS_TEXTURE, recorded);
+		if (!n || createdTextures.count(n))
+			return;
+		auto it = textures.find(TextureKey(activeTexture, target));
+		glBindTexture(target, n);
+		glBindTexture(target, it == textures.end() ? 0 : it->second);
+		createdTextures.insert(n);
+	}
+
+	void BindVertexArray(uint32_t recorded)
+	{
+		GLuint n = Name(TRACE_NS_VERTEX_ARRAY, recorded);
+		if (vertexArray != n)
+			glBindVertexArray(vertexArray = n);
+	}
+
+	void BindFramebuffer(GLenum target, uint32_t recorded)
+	{
+		GLuint n = Framebuffer(recorded);
+		if (target == GL_READ_FRAMEBUFFER ? readFramebuffer != n : drawFramebuffer != n) {
+			if (target != GL_DRAW_FRAMEBUFFER)
+				readFramebuffer = n;
+			if (target != GL_READ_FRAMEBUFFER)
+				drawFramebuffer = n;
+			glBindFramebuffer(target, n);
+		}
+	}
+};
+
+// Headless OpenGL 3.3 core context. Returns false if EGL can't provide one.
+static bool createContext()
+{
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+		std::cerr << "ERROR: Could not initialize EGL\n";
+		return false;
+	}
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		std::cerr << "ERROR: EGL doesn't support desktop OpenGL\n";
+		return false;
+	}
+
+	const EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+		std::cerr << "ERROR: No EGL config for OpenGL\n";
+		return false;
+	}
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT) {
+		std::cerr << "ERROR: Could not create an OpenGL 3.3 core context\n";
+		return false;
+	}
+
+	// Everything is drawn into our own framebuffer, so no surface is needed if the driver allows it
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		EGLSurface surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+		if (surface == EGL_NO_SURFACE || !eglMakeCurrent(display, surface, surface, context)) {
+			std::cerr << "ERROR: Could not make the EGL context current\n";
+			return false;
+		}
+	}
+
+	if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+		std::cerr << "ERROR: Could not initialize GLAD\n";
+		return false;
+	}
+	return true;
+}
+
+static bool writeScreenshot(const char* path, GLuint framebuffer, int width, int height)
+{
+	std::vector<unsigned char> pixels((size_t)width * height * 3);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+
+	std::ofstream out(path, std::ios::binary);
+	if (!out.is_open())
+		return false;
+	out << "P6\n" << width << " " << height << "\n255\n";
+	for (int y = height - 1; y >= 0; y--)
+		out.write((const char*)&pixels[(size_t)y * width * 3], width * 3);
+	return out.good();
+}
+
+int main(int argc, char** argv)
+{
+	const char* tracePath = nullptr;
+	const char* screenshotPath = nullptr;
+	int loops = 100;
+	int warmup = 5;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--loops" && i + 1 < argc)
+			loops = std::max(1, atoi(argv[++i]));
+		else if (arg == "--warmup" && i + 1 < argc)
+			warmup = std::max(0, atoi(argv[++i]));
+		else if (arg == "--screenshot" && i + 1 < argc)
+			screenshotPath = argv[++i];
+		else if (!tracePath)
+			tracePath = argv[i];
+		else {
+			std::cerr << "ERROR: Unexpected argument " << arg << "\n";
+			return 1;
+		}
+	}
+	if (!tracePath) {
+		std::cerr << "Usage: GLReplay <trace> [--loops N] [--warmup N] [--screenshot out.ppm]\n";
+		return 1;
+	}
+
+	MappedFile file;
+	TraceHeader header;
+	std::vector<TraceRecord> records;
+	if (!file.Open(tracePath)) {
+		std::cerr << "ERROR: Could not open " << tracePath << "\n";
+		return 1;
+	}
+	if (!parseTrace(file.getView(), header, records)) {
+		std::cerr << "ERROR: " << tracePath << " is not a valid trace\n";
+		return 1;
+	}
+
+	if (!createContext())
+		return 1;
+	std::cout << "Replaying " << tracePath << " (" << header.width << "x" << header.height << ", " << header.prologueCount
+		<< " prologue + " << header.frameCount << " frame calls) on " << glGetString(GL_RENDERER) << "\n";
+
+	// Stand-in for the default framebuffer
+	GLuint framebuffer, color, depth;
+	glGenFramebuffers(1, &framebuffer);
+	glGenRenderbuffers(1, &color);
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, header.width, header.height);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, header.width, header.height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "ERROR: Could not create a " << header.width << "x" << header.height << " framebuffer\n";
+		return 1;
+	}
+
+	Replayer replayer(framebuffer);
+	auto start = Clock::now();
+	for (uint32_t i = 0; i < header.prologueCount; i++)
+		replayer.Execute(records[i]);
+	glFinish();
+	float prologueTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+	std::cout << "Prologue: " << prologueTime << "ms\n";
+
+	// Per call type: number of calls and time spent submitting them
+	double callTime[TRACE_OP_COUNT] = {};
+	size_t callCount[TRACE_OP_COUNT] = {};
+	std::vector<float> cpuTimes, gpuTimes;
+	GLuint query;
+	glGenQueries(1, &query);
+
+	const TraceRecord* frameBegin = records.data() + header.prologueCount;
+	const TraceRecord* frameEnd = records.data() + records.size();
+	for (int loop = 0; loop < warmup + loops; loop++) {
+		bool measured = loop >= warmup;
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		replayer.BeginFrame();
+		auto frameStart = Clock::now();
+		for (const TraceRecord* r = frameBegin; r != frameEnd; ++r) {
+			if (!measured) {
+				replayer.Execute(*r);
+				continue;
+			}
+			auto callStart = Clock::now();
+			replayer.Execute(*r);
+			callTime[r->op] += std::chrono::duration<double, std::micro>(Clock::now() - callStart).count();
+			callCount[r->op]++;
+		}
+		glEndQuery(GL_TIME_ELAPSED);
+		glFinish();
+		float cpuTime = std::chrono::duration<float, std::milli>(Clock::now() - frameStart).count();
+		replayer.EndFrame();
+
+		GLuint64 gpuTime = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpuTime);
+		if (measured) {
+			cpuTimes.push_back(cpuTime);
+			gpuTimes.push_back(gpuTime / 1000000.0f);
+		}
+	}
+	glDeleteQueries(1, &query);
+
+	std::sort(cpuTimes.begin(), cpuTimes.end());
+	std::sort(gpuTimes.begin(), gpuTimes.end());
+	float cpuTotal = 0.0f, gpuTotal = 0.0f;
+	for (int i = 0; i < loops; i++) {
+		cpuTotal += cpuTimes[i];
+		gpuTotal += gpuTimes[i];
+	}
+	printf("Frame (%d loops, including glFinish): avg %.3fms, median %.3fms, min %.3fms, max %.3fms | GPU avg %.3fms\n",
+		loops, cpuTotal / loops, cpuTimes[loops / 2], cpuTimes.front(), cpuTimes.back(), gpuTotal / loops);
+
+	// Call types sorted by the time spent in them
+	std::vector<int> ops;
+	double submitTotal = 0.0;
+	for (int op = 0; op < TRACE_OP_COUNT; op++) {
+		if (callCount[op])
+			ops.push_back(op);
+		submitTotal += callTime[op];
+	}
+	std::sort(ops.begin(), ops.end(), [&](int a, int b) { return callTime[a] > callTime[b]; });
+
+	printf("\n%-40s %10s %12s %10s %7s\n", "Call", "Per frame", "Per frame us", "Avg us", "Share");
+	for (int op : ops) {
+		printf("%-40s %10zu %12.2f %10.3f %6.1f%%\n", getTraceOpInfo(op).name, callCount[op] / loops, callTime[op] / loops,
+			callTime[op] / callCount[op], submitTotal > 0.0 ? 100.0 * callTime[op] / submitTotal : 0.0);
+	}
+	printf("%-40s %10zu %12.2f\n", "Total", (size_t)header.frameCount, submitTotal / loops);
+
+	if (screenshotPath) {
+		if (writeScreenshot(screenshotPath, framebuffer, header.width, header.height))
+			std::cout << "Wrote " << screenshotPath << "\n";
+		else
+			std::cerr << "ERROR: Could not write " << screenshotPath << "\n";
+	}
+	return 0;
+}
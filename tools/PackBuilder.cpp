@@ -0,0 +1,100 @@
+// Packs a directory into a single file that the engine mounts through VirtualFileSystem.
+//
+// Usage: PackBuilder <directory> <output.pak> [--compress] [--align N]
+//
+// Paths inside the pack are relative to the directory, so packing the folder that contains "shaders/" and
+// "assets/" keeps paths like "assets/container.jpg" working unchanged.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <stdlib.h>
+
+#include "../FileSystem.hpp"
+
+namespace fs = std::filesystem;
+
+static bool readFile(const fs::path& path, std::vector<unsigned char>& data)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return false;
+	data.resize((size_t)file.tellg());
+	file.seekg(0);
+	return data.empty() || (bool)file.read((char*)&data[0], data.size());
+}
+
+int main(int argc, char** argv)
+{
+	std::string input, output;
+	bool compress = false;
+	unsigned int alignment = 16;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--compress")
+			compress = true;
+		else if (arg == "--align" && i + 1 < argc)
+			alignment = (unsigned int)atoi(argv[++i]);
+		else if (input.empty())
+			input = arg;
+		else if (output.empty())
+			output = arg;
+		else {
+			std::cerr << "ERROR: Unexpected argument " << arg << "\n";
+			return 1;
+		}
+	}
+	if (input.empty() || output.empty() || alignment == 0) {
+		std::cerr << "Usage: PackBuilder <directory> <output.pak> [--compress] [--align N]\n";
+		return 1;
+	}
+	#ifndef NGE_USE_LZ4
+		if (compress)
+			std::cerr << "WARNING: Built without NGE_USE_LZ4, entries are stored uncompressed\n";
+	#endif
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Sorted so that the same directory always produces the same pack
+	std::vector<fs::path> files;
+	std::error_code error;
+	for (fs::recursive_directory_iterator it(input, error), end; !error && it != end; it.increment(error))
+		if (it->is_regular_file() && fs::absolute(it->path()) != fs::absolute(output))
+			files.push_back(it->path());
+	if (error) {
+		std::cerr << "ERROR: Could not read directory " << input << ": " << error.message() << "\n";
+		return 1;
+	}
+	std::sort(files.begin(), files.end());
+
+	PackWriter writer(alignment);
+	size_t totalBytes = 0;
+	for (const fs::path& path : files) {
+		std::vector<unsigned char> data;
+		if (!readFile(path, data)) {
+			std::cerr << "ERROR: Could not read " << path.string() << "\n";
+			return 1;
+		}
+		totalBytes += data.size();
+		writer.Add(fs::relative(path, input).generic_string(), std::move(data), compress);
+	}
+
+	if (!writer.Write(output.c_str()))
+		return 1;
+
+	// Read the result back to make sure every entry survives the round trip
+	if (!VirtualFileSystem::Get().Mount(output.c_str()) || !VirtualFileSystem::Get().VerifyAll()) {
+		std::cerr << "ERROR: Verification of " << output << " failed\n";
+		return 1;
+	}
+
+	float time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "Packed " << writer.getFileCount() << " files (" << totalBytes / 1024 << " KiB) into " << output
+		<< " (" << fs::file_size(output) / 1024 << " KiB) in " << time << "ms\n";
+	return 0;
+}
@@ -0,0 +1,206 @@
+// Benchmarks SpatialGrid against testing every pair of bodies. Boxes fly around a world that grows with the body
+// count so the density stays the same, which is where a broadphase should scale linearly and brute force can't.
+//
+// Usage: SpatialBench [--bodies N] [--frames N] [--brute-limit N]
+//
+// Brute force is quadratic, so it only runs up to --brute-limit bodies (20000 by default). Whenever it runs the
+// grid's pairs are checked against it.
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Spatial.hpp"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+struct MovingBody
+{
+	glm::vec3 position;
+	glm::vec3 extent;
+	glm::vec3 velocity;
+	uint32_t id;
+};
+
+static float millisecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+}
+
+static unsigned long long bruteForcePairs(const std::vector<MovingBody>& bodies, const SpatialGrid& grid, std::vector<BodyPair>& pairs)
+{
+	unsigned long long tested = 0;
+	pairs.clear();
+	for (size_t i = 0; i < bodies.size(); i++) {
+		const AABB& a = grid.getBounds(bodies[i].id);
+		for (size_t j = i + 1; j < bodies.size(); j++) {
+			tested++;
+			if (a.Overlaps(grid.getBounds(bodies[j].id)))
+				pairs.push_back({ std::min(bodies[i].id, bodies[j].id), std::max(bodies[i].id, bodies[j].id) });
+		}
+	}
+	return tested;
+}
+
+static bool samePairs(std::vector<BodyPair> a, std::vector<BodyPair> b)
+{
+	auto less = [](const BodyPair& x, const BodyPair& y) { return x.a != y.a ? x.a < y.a : x.b < y.b; };
+	std::sort(a.begin(), a.end(), less);
+	std::sort(b.begin(), b.end(), less);
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+		if (a[i].a != b[i].a || a[i].b != b[i].b)
+			return false;
+	return true;
+}
+
+// Runs one body count, returns false if the grid disagreed with brute force
+static bool runBenchmark(size_t count, int frames, bool bruteForce, JobSystem& jobs)
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	// One body per 8 cubic units on average
+	float worldSize = 2.0f * cbrt((float)count);
+	SpatialGrid grid(2.0f);
+	std::vector<MovingBody> bodies(count);
+	for (MovingBody& body : bodies) {
+		body.position = glm::vec3(unit(rng), unit(rng), unit(rng)) * worldSize;
+		body.extent = glm::vec3(0.25f + unit(rng) * 0.5f);
+		body.velocity = (glm::vec3(unit(rng), unit(rng), unit(rng)) * 2.0f - glm::vec3(1.0f)) * 2.0f;
+		body.id = grid.Insert(AABB::FromCenter(body.position, body.extent));
+	}
+
+	float updateTime = 0.0f, pairTime = 0.0f, jobTime = 0.0f, bruteTime = 0.0f;
+	unsigned long long tested = 0, bruteTested = 0;
+	unsigned int found = 0, moves = 0;
+	bool matches = true;
+	std::vector<BodyPair> pairs, jobPairs, brutePairs;
+
+	for (int frame = 0; frame < frames; frame++) {
+		// Move everything, bouncing off the walls of the world
+		auto start = Clock::now();
+		for (MovingBody& body : bodies) {
+			body.position += body.velocity * (1.0f / 60.0f);
+			for (int i = 0; i < 3; i++) {
+				if ((body.position[i] < 0.0f && body.velocity[i] < 0.0f) || (body.position[i] > worldSize && body.velocity[i] > 0.0f))
+					body.velocity[i] = -body.velocity[i];
+			}
+			grid.Update(body.id, AABB::FromCenter(body.position, body.extent));
+		}
+		updateTime += millisecondsSince(start);
+
+		grid.FindPairs(pairs);
+		moves += grid.getStats().cellMoves;
+		pairTime += grid.getStats().pairTime;
+		tested += grid.getStats().pairsTested;
+		found += grid.getStats().pairsFound;
+
+		grid.FindPairs(jobPairs, jobs);
+		jobTime += grid.getStats().pairTime;
+
+		if (bruteForce) {
+			start = Clock::now();
+			bruteTested += bruteForcePairs(bodies, grid, brutePairs);
+			bruteTime += millisecondsSince(start);
+			matches = matches && samePairs(pairs, brutePairs) && samePairs(jobPairs, brutePairs);
+		}
+	}
+
+	printf("%8zu %10.3f %10.3f %10.3f %12llu %8u", count, updateTime / frames, pairTime / frames, jobTime / frames, tested / frames, found / frames);
+	if (bruteForce)
+		printf(" %10.2f %14llu %9.1fx", bruteTime / frames, bruteTested / frames, bruteTime / std::max(pairTime, 0.001f));
+	else
+		printf(" %10s %14s %10s", "-", "-", "-");
+	printf(" %8.1f%%\n", 100.0f * moves / ((float)count * frames));
+
+	// Queries against the final positions, timed as batches
+	std::vector<Ray> rays(10000);
+	for (Ray& ray : rays) {
+		glm::vec3 direction = glm::vec3(unit(rng), unit(rng), unit(rng)) * 2.0f - glm::vec3(1.0f);
+		ray = Ray(glm::vec3(unit(rng), unit(rng), unit(rng)) * worldSize, glm::normalize(direction), worldSize);
+	}
+	std::vector<Sphere> spheres(10000);
+	for (Sphere& sphere : spheres)
+		sphere = { glm::vec3(unit(rng), unit(rng), unit(rng)) * worldSize, 2.0f };
+
+	std::vector<RayHit> hits;
+	std::vector<std::vector<uint32_t>> overlaps;
+	auto start = Clock::now();
+	grid.RaycastBatch(rays, hits, jobs);
+	float rayTime = millisecondsSince(start);
+	start = Clock::now();
+	grid.OverlapSphereBatch(spheres, overlaps, jobs);
+	float sphereTime = millisecondsSince(start);
+	size_t rayHits = std::count_if(hits.begin(), hits.end(), [](const RayHit& hit) { return hit.body != INVALID_BODY; });
+	size_t sphereHits = 0;
+	for (const std::vector<uint32_t>& results : overlaps)
+		sphereHits += results.size();
+	printf("%8s 10000 rays in %.3f ms (%zu hits), 10000 sphere overlaps in %.3f ms (%zu bodies)\n", "", rayTime, rayHits, sphereTime, sphereHits);
+
+	// Check a few queries against testing every body
+	if (bruteForce) {
+		for (size_t i = 0; i < 100; i++) {
+			float closest = rays[i].maxDistance;
+			size_t inside = 0;
+			for (const MovingBody& body : bodies) {
+				const AABB& bounds = grid.getBounds(body.id);
+				float tEnter, tExit;
+				int axis;
+				if (bounds.IntersectRay(rays[i].origin, rays[i].direction, tEnter, tExit, axis))
+					closest = std::min(closest, std::max(tEnter, 0.0f));
+				if (bounds.OverlapsSphere(spheres[i].center, spheres[i].radius))
+					inside++;
+			}
+			float distance = hits[i].body != INVALID_BODY ? hits[i].distance : rays[i].maxDistance;
+			if (fabs(distance - closest) > 1e-3f || inside != overlaps[i].size())
+				matches = false;
+		}
+	}
+
+	if (!matches)
+		std::cerr << "ERROR: Grid results don't match brute force with " << count << " bodies\n";
+	return matches;
+}
+
+int main(int argc, char** argv)
+{
+	size_t maxBodies = 100000;
+	size_t bruteLimit = 20000;
+	int frames = 10;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--bodies") && i + 1 < argc)
+			maxBodies = (size_t)atol(argv[++i]);
+		else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+			frames = std::max(1, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "--brute-limit") && i + 1 < argc)
+			bruteLimit = (size_t)atol(argv[++i]);
+		else {
+			std::cerr << "Usage: SpatialBench [--bodies N] [--frames N] [--brute-limit N]\n";
+			return 1;
+		}
+	}
+
+	JobSystem jobs;
+	printf("Averages per frame over %d frames. Times in ms, tested = bounds tests.\n\n", frames);
+	printf("%8s %10s %10s %10s %12s %8s %10s %14s %10s %9s\n", "Bodies", "Update", "Pairs", "Pairs jobs", "Tested", "Found", "Brute", "Brute tested", "Speedup", "Moved");
+
+	bool ok = true;
+	const size_t steps[] = { 1, 2, 5 };
+	for (size_t scale = 1000; scale <= maxBodies; scale *= 10) {
+		for (size_t step : steps) {
+			size_t count = scale * step;
+			if (count > maxBodies)
+				break;
+			ok = runBenchmark(count, frames, count <= bruteLimit, jobs) && ok;
+		}
+	}
+	return ok ? 0 : 1;
+}
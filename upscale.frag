@@ -0,0 +1,33 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 outTexCoord;
+
+uniform sampler2D sceneColor;
+uniform vec2 uvScale;    // Rendered size over texture size, the scene only fills the bottom left corner
+uniform vec2 texelSize;  // One texel of the scene texture in UV units
+uniform float sharpness; // 0 is a plain bilinear upscale
+
+// Stays half a texel inside the rendered area so filtering never pulls in pixels from older, larger frames
+vec3 fetch(vec2 uv)
+{
+    return texture(sceneColor, clamp(uv, texelSize * 0.5, uvScale - texelSize * 0.5)).rgb;
+}
+
+void main()
+{
+    vec2 uv = outTexCoord * uvScale;
+    vec3 color = fetch(uv);
+    if (sharpness > 0.0) {
+        // Unsharp mask against the four neighbours, clamped to their range so edges don't ring
+        vec3 north = fetch(uv + vec2(0.0, texelSize.y));
+        vec3 south = fetch(uv - vec2(0.0, texelSize.y));
+        vec3 east = fetch(uv + vec2(texelSize.x, 0.0));
+        vec3 west = fetch(uv - vec2(texelSize.x, 0.0));
+        vec3 low = min(color, min(min(north, south), min(east, west)));
+        vec3 high = max(color, max(max(north, south), max(east, west)));
+        vec3 blurred = (north + south + east + west) * 0.25;
+        color = clamp(color + (color - blurred) * sharpness, low, high);
+    }
+    FragColor = vec4(color, 1.0);
+}
\ No newline at end of file
@@ -10,6 +10,9 @@
 #include <glad/glad.h>
 
 #ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX // Keeps Windows.h from defining min and max macros, which break std::min and std::max
+#endif
 #include <Windows.h>
 void sleep(float milliseconds) { Sleep(milliseconds); }
 #else